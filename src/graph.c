@@ -2,6 +2,13 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "graph.h"
 
@@ -47,7 +54,7 @@ void matrix_al_print(struct matrix_al *m) {
     return;
   }
   for (size_t i = 0; i < m->pairs_size; i++) {
-    printf("(%lu, %lu)\n", m->pairs[i].i, m->pairs[i].j);
+    printf("(%" PRInumber ", %" PRInumber ")\n", m->pairs[i].i, m->pairs[i].j);
   }
 }
 
@@ -60,7 +67,7 @@ void matrix_al_as_dot(struct matrix_al *m, FILE *f) {
     if (m->pairs[i].i >= m->pairs[i].j) {
       continue;
     }
-    fprintf(f, "  %lu -- %lu;\n", m->pairs[i].i, m->pairs[i].j);
+    fprintf(f, "  %" PRInumber " -- %" PRInumber ";\n", m->pairs[i].i, m->pairs[i].j);
   }
   fprintf(f, "}\n");
 }
@@ -72,32 +79,43 @@ void matrix_as_dot_color(const struct matrix *m, FILE *f, const struct coloring
   fprintf(f, "graph G {\n");
   for (size_t i = 0; i < m->n_vertices; i++) {
     if (c->colors[i] < color_names_length) {
-      fprintf(f, "  %lu [color=%s];\n", i, color_names[c->colors[i]]);
+      fprintf(f, "  %zu [color=%s];\n", i, color_names[c->colors[i]]);
     }
     for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
-      fprintf(f, "  %lu -- %lu;\n", i, m->col_index[j]);
+      fprintf(f, "  %zu -- %" PRInumber ";\n", i, m->col_index[j]);
     }
   }
   fprintf(f, "}\n");
 }
 
+// index of the first of the sorted pairs[0..n) not less than (i, j)
+static size_t matrix_al_lower_bound(const struct matrix_al_pair *pairs, size_t n, number_t i, number_t j) {
+  size_t lo = 0;
+  size_t hi = n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (pairs[mid].i < i || (pairs[mid].i == i && pairs[mid].j < j)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
 bool matrix_al_query(struct matrix_al *m, number_t i, number_t j) {
   if (m == NULL) {
     return false;
   }
-  // TODO: binary search
-  for (size_t k = 0; k < m->pairs_size; k++) {
-    if (m->pairs[k].i == i && m->pairs[k].j == j) {
-      return true;
-    }
-  }
-  return false;
+  size_t k = matrix_al_lower_bound(m->pairs, m->pairs_size, i, j);
+  return k < m->pairs_size && m->pairs[k].i == i && m->pairs[k].j == j;
 }
 
 void matrix_al_fill_random(struct matrix_al *m) {
   if (m == NULL) {
     return;
   }
+  // pairs[0..count) are kept sorted, so each new pair is inserted in place
   for (size_t count = 0; count < m->pairs_size;) {
     number_t i = random() % m->n_vertices;
     number_t j = random() % m->n_vertices;
@@ -106,11 +124,13 @@ void matrix_al_fill_random(struct matrix_al *m) {
       i = j;
       j = tmp;
     }
-    if (matrix_al_query(m, i, j)) {
+    size_t k = matrix_al_lower_bound(m->pairs, count, i, j);
+    if (k < count && m->pairs[k].i == i && m->pairs[k].j == j) {
       continue;
     }
-    m->pairs[count].i = i;
-    m->pairs[count].j = j;
+    memmove(&m->pairs[k + 1], &m->pairs[k], (count - k) * sizeof(struct matrix_al_pair));
+    m->pairs[k].i = i;
+    m->pairs[k].j = j;
     count++;
   }
 }
@@ -121,7 +141,7 @@ bool matrix_al_verify_coloring(struct matrix_al *m, struct coloring *c) {
   }
   for (size_t i = 0; i < m->pairs_size; i++) {
     if (c->colors[m->pairs[i].i] == c->colors[m->pairs[i].j]) {
-      printf("Invalid coloring at (%lu, %lu)\n", m->pairs[i].i, m->pairs[i].j);
+      printf("Invalid coloring at (%" PRInumber ", %" PRInumber ")\n", m->pairs[i].i, m->pairs[i].j);
       return false;
     }
   }
@@ -138,6 +158,8 @@ struct matrix *matrix_create(const size_t n_vertices, const size_t nnz) {
   }
   m->n_vertices = n_vertices;
   m->nnz = nnz;
+  m->mapping = NULL;
+  m->mapping_size = 0;
 #ifdef DEBUG
   printf("allocate matrix.col_index - %lx bytes\n", nnz * sizeof(number_t));
 #endif
@@ -147,9 +169,9 @@ struct matrix *matrix_create(const size_t n_vertices, const size_t nnz) {
     return NULL;
   }
 #ifdef DEBUG
-  printf("allocate matrix.row_index - %lx bytes\n", (n_vertices + 1) * sizeof(number_t));
+  printf("allocate matrix.row_index - %lx bytes\n", (n_vertices + 1) * sizeof(offset_t));
 #endif
-  m->row_index = malloc((n_vertices + 1) * sizeof(number_t));
+  m->row_index = malloc((n_vertices + 1) * sizeof(offset_t));
   if (m->row_index == NULL) {
     free(m->col_index);
     free(m);
@@ -158,66 +180,452 @@ struct matrix *matrix_create(const size_t n_vertices, const size_t nnz) {
   return m;
 }
 
-struct matrix *matrix_create_random(const size_t n_vertices, const size_t n_edges) {
-  // TODO: make a random adjacency matrix first, then convert it to CSR
-  //       inefficient but easy to implement
-#ifdef DEBUG
-  printf("allocate matrix - %lx bytes\n", (n_vertices * n_vertices) * sizeof(number_t));
-#endif
-  number_t *am = calloc(n_vertices * n_vertices, sizeof(number_t));
-  if (am == NULL) {
-    return NULL;
+// === vertex sets ===
+
+uint64_t *vset_create(const size_t n) {
+  return calloc(VSET_WORDS(n), sizeof(uint64_t));
+}
+
+void vset_union(uint64_t *a, const uint64_t *b, const size_t n) {
+#pragma omp parallel for schedule(static)
+  for (size_t w = 0; w < VSET_WORDS(n); w++) {
+    a[w] |= b[w];
+  }
+}
+
+void vset_difference(uint64_t *a, const uint64_t *b, const size_t n) {
+#pragma omp parallel for schedule(static)
+  for (size_t w = 0; w < VSET_WORDS(n); w++) {
+    a[w] &= ~b[w];
+  }
+}
+
+size_t vset_count(const uint64_t *s, const size_t n) {
+  size_t count = 0;
+#pragma omp parallel for schedule(static) reduction(+:count)
+  for (size_t w = 0; w < VSET_WORDS(n); w++) {
+    count += __builtin_popcountll(s[w]);
+  }
+  return count;
+}
+
+// === random graph generation ===
+
+offset_t exclusive_scan(offset_t *a, const size_t n) {
+  // the per-thread sums live on the stack, so that worklist compaction in
+  // every solver round stays free of heap allocation
+  const int max_threads = omp_get_max_threads();
+  offset_t partial[max_threads + 1];
+  partial[0] = 0;
+  int n_threads = 1;
+#pragma omp parallel num_threads(max_threads) shared(partial, n_threads)
+  {
+#pragma omp single
+    n_threads = omp_get_num_threads();
+    const size_t tid = omp_get_thread_num();
+    const size_t begin = n * tid / n_threads;
+    const size_t end = n * (tid + 1) / n_threads;
+    offset_t sum = 0;
+    for (size_t i = begin; i < end; i++) {
+      sum += a[i];
+    }
+    partial[tid + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+    for (int t = 0; t < n_threads; t++) {
+      partial[t + 1] += partial[t];
+    }
+    offset_t running = partial[tid];
+    for (size_t i = begin; i < end; i++) {
+      offset_t x = a[i];
+      a[i] = running;
+      running += x;
+    }
+  }
+  return partial[n_threads];
+}
+
+static int number_compar(const void *a, const void *b) {
+  number_t x = *(const number_t *) a;
+  number_t y = *(const number_t *) b;
+  return (x > y) - (x < y);
+}
+
+static void sort_row(number_t *a, const size_t n) {
+  if (n > 32) {
+    qsort(a, n, sizeof(number_t), number_compar);
+    return;
   }
-  for (size_t count = 0; count < n_edges;) {
-    number_t i = random() % n_vertices;
-    number_t j = random() % n_vertices;
-    if (am[i * n_vertices + j] ||
-        am[j * n_vertices + i] ||
-        i == j) {
+  for (size_t j = 1; j < n; j++) {
+    number_t v = a[j];
+    size_t k = j;
+    while (k > 0 && a[k - 1] > v) {
+      a[k] = a[k - 1];
+      k--;
+    }
+    a[k] = v;
+  }
+}
+
+struct matrix *matrix_create_from_edges(const size_t n_vertices, const struct matrix_al_pair *edges, const size_t n_edges) {
+  offset_t *start = calloc(n_vertices + 1, sizeof(offset_t));
+  offset_t *cursor = malloc((n_vertices + 1) * sizeof(offset_t));
+  offset_t *unique = calloc(n_vertices + 1, sizeof(offset_t));
+  number_t *scratch = NULL;
+  struct matrix *m = NULL;
+  if (start == NULL || cursor == NULL || unique == NULL) {
+    goto out;
+  }
+
+  // degree count; self-loops are dropped
+#pragma omp parallel for
+  for (size_t e = 0; e < n_edges; e++) {
+    assert(edges[e].i < n_vertices && edges[e].j < n_vertices);
+    if (edges[e].i == edges[e].j) {
       continue;
     }
-    am[i * n_vertices + j] = 1;
-    am[j * n_vertices + i] = 1;
-    count++;
+#pragma omp atomic
+    start[edges[e].i]++;
+#pragma omp atomic
+    start[edges[e].j]++;
+  }
+  offset_t total = exclusive_scan(start, n_vertices + 1);
+  memcpy(cursor, start, (n_vertices + 1) * sizeof(offset_t));
+
+  // scatter both orientations of each edge (a counting sort on the row)
+  scratch = malloc(total * sizeof(number_t));
+  if (scratch == NULL && total > 0) {
+    goto out;
+  }
+#pragma omp parallel for
+  for (size_t e = 0; e < n_edges; e++) {
+    if (edges[e].i == edges[e].j) {
+      continue;
+    }
+    offset_t slot;
+#pragma omp atomic capture
+    slot = cursor[edges[e].i]++;
+    scratch[slot] = edges[e].j;
+#pragma omp atomic capture
+    slot = cursor[edges[e].j]++;
+    scratch[slot] = edges[e].i;
   }
 
-  struct matrix *m = matrix_create(n_vertices, 2*n_edges);
+  // scatter order depends on scheduling, so sort each row, then count the
+  // distinct entries
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < n_vertices; i++) {
+    number_t *row = scratch + start[i];
+    const size_t length = start[i + 1] - start[i];
+    sort_row(row, length);
+    size_t count = 0;
+    for (size_t j = 0; j < length; j++) {
+      if (j == 0 || row[j] != row[j - 1]) {
+        count++;
+      }
+    }
+    unique[i] = count;
+  }
+  offset_t nnz = exclusive_scan(unique, n_vertices + 1);
+
+  m = matrix_create(n_vertices, nnz);
   if (m == NULL) {
-    free(am);
-    return NULL;
+    goto out;
   }
-  // fill row_index
-  {
-    size_t total_nz = 0;
-    for (size_t i = 0; i < m->n_vertices; i++) {
-      m->row_index[i] = total_nz;
-      for (size_t j = 0; j < m->n_vertices; j++) {
-        if (am[i * m->n_vertices + j]) {
-          total_nz++;
-        }
+  memcpy(m->row_index, unique, (n_vertices + 1) * sizeof(offset_t));
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < n_vertices; i++) {
+    const number_t *row = scratch + start[i];
+    const size_t length = start[i + 1] - start[i];
+    size_t k = m->row_index[i];
+    for (size_t j = 0; j < length; j++) {
+      if (j == 0 || row[j] != row[j - 1]) {
+        m->col_index[k++] = row[j];
       }
     }
-    m->row_index[m->n_vertices] = total_nz;
+    assert(k == m->row_index[i + 1]);
   }
-  // fill col_index
-  {
-    size_t total_nz = 0;
-    for (size_t i = 0; i < m->n_vertices; i++) {
-      for (size_t j = 0; j < m->n_vertices; j++) {
-        if (am[i * m->n_vertices + j]) {
-          m->col_index[total_nz] = j;
-          total_nz++;
+
+out:
+  free(start);
+  free(cursor);
+  free(unique);
+  free(scratch);
+  return m;
+}
+
+// Candidate e of a random graph is the pair hashed from e, smaller endpoint
+// first; i == j is a self-loop and never becomes an edge.
+static inline void random_candidate(const uint64_t e, const size_t n_vertices, number_t *i, number_t *j) {
+  number_t a = hash64(2*e) % n_vertices;
+  number_t b = hash64(2*e + 1) % n_vertices;
+  *i = a < b ? a : b;
+  *j = a < b ? b : a;
+}
+
+// A candidate in the bucket of its smaller endpoint.
+struct random_slot {
+  number_t j;
+  offset_t e;
+};
+
+static int random_slot_compar(const void *a, const void *b) {
+  const struct random_slot *x = a;
+  const struct random_slot *y = b;
+  if (x->j != y->j) {
+    return (x->j > y->j) - (x->j < y->j);
+  }
+  return (x->e > y->e) - (x->e < y->e);
+}
+
+// Sorts a bucket by (j, e), as sort_row does a row.
+static void sort_slots(struct random_slot *a, const size_t n) {
+  if (n > 32) {
+    qsort(a, n, sizeof(struct random_slot), random_slot_compar);
+    return;
+  }
+  for (size_t k = 1; k < n; k++) {
+    struct random_slot v = a[k];
+    size_t l = k;
+    while (l > 0 && random_slot_compar(&a[l - 1], &v) > 0) {
+      a[l] = a[l - 1];
+      l--;
+    }
+    a[l] = v;
+  }
+}
+
+// Writes the first n_pairs distinct pairs of the candidate sequence to pairs,
+// sorted by (i, j). They only depend on (n_vertices, n_pairs), not on the
+// number of threads or rounds. Returns 0 on success.
+//
+// Each round buckets the owners found so far (the first candidate of each
+// distinct pair) together with newly drawn candidates by their smaller
+// endpoint, sorts every bucket by (j, e) and keeps the first occurrence of
+// each pair. If too few distinct pairs came out, only the owners are kept and
+// a multiple of the shortfall is drawn next. Otherwise the owners with the
+// n_pairs smallest candidate indices are written out.
+static int random_distinct_pairs(const size_t n_vertices, const size_t n_pairs, struct matrix_al_pair *pairs) {
+  if (n_pairs == 0) {
+    return 0;
+  }
+  offset_t *kept = NULL;
+  struct random_slot *slots = NULL;
+  offset_t *bucket_index = NULL;
+  offset_t *cursor = NULL;
+  offset_t *distinct = NULL;
+  offset_t *owned = NULL;
+  int status = 1;
+  size_t n_kept = 0;
+  size_t drawn = 0;
+  size_t extra = n_pairs + n_pairs / 8 + 64;
+  for (size_t round = 0;; round++) {
+    const size_t n_candidates = n_kept + extra;
+#ifdef DEBUG
+    printf("allocate candidates - %lx bytes\n", n_candidates * sizeof(struct random_slot));
+#endif
+    slots = malloc(n_candidates * sizeof(struct random_slot));
+    bucket_index = calloc(n_vertices + 1, sizeof(offset_t));
+    cursor = malloc((n_vertices + 1) * sizeof(offset_t));
+    distinct = malloc((n_vertices + 1) * sizeof(offset_t));
+    if (slots == NULL || bucket_index == NULL || cursor == NULL || distinct == NULL) {
+      goto out;
+    }
+
+    // candidate c is an owner kept from earlier rounds or the next draw
+#pragma omp parallel for
+    for (size_t c = 0; c < n_candidates; c++) {
+      number_t i;
+      number_t j;
+      random_candidate(c < n_kept ? kept[c] : drawn + (c - n_kept), n_vertices, &i, &j);
+      if (i != j) {
+#pragma omp atomic
+        bucket_index[i]++;
+      }
+    }
+    exclusive_scan(bucket_index, n_vertices + 1);
+    memcpy(cursor, bucket_index, (n_vertices + 1) * sizeof(offset_t));
+#pragma omp parallel for
+    for (size_t c = 0; c < n_candidates; c++) {
+      offset_t e = c < n_kept ? kept[c] : drawn + (c - n_kept);
+      number_t i;
+      number_t j;
+      random_candidate(e, n_vertices, &i, &j);
+      if (i == j) {
+        continue;
+      }
+      offset_t slot;
+#pragma omp atomic capture
+      slot = cursor[i]++;
+      slots[slot] = (struct random_slot) { .j = j, .e = e };
+    }
+    drawn += extra;
+
+    // sort each bucket and move the first occurrence of each pair to its front
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < n_vertices; i++) {
+      struct random_slot *bucket = slots + bucket_index[i];
+      const size_t length = bucket_index[i + 1] - bucket_index[i];
+      sort_slots(bucket, length);
+      size_t count = 0;
+      for (size_t k = 0; k < length; k++) {
+        if (k == 0 || bucket[k].j != bucket[k - 1].j) {
+          bucket[count++] = bucket[k];
         }
       }
+      distinct[i] = count;
+    }
+    distinct[n_vertices] = 0;
+    const size_t n_distinct = exclusive_scan(distinct, n_vertices + 1);
+    if (n_distinct >= n_pairs) {
+      break;
+    }
+
+    // keep the owners, and draw more the more rounds it takes
+    free(kept);
+    kept = malloc(n_distinct * sizeof(offset_t));
+    if (kept == NULL) {
+      goto out;
+    }
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < n_vertices; i++) {
+      for (size_t k = 0; k < distinct[i + 1] - distinct[i]; k++) {
+        kept[distinct[i] + k] = slots[bucket_index[i] + k].e;
+      }
+    }
+    n_kept = n_distinct;
+    extra = ((n_pairs - n_distinct) << (round + 1)) + 64;
+    free(slots);
+    free(bucket_index);
+    free(cursor);
+    free(distinct);
+    slots = NULL;
+    bucket_index = NULL;
+    cursor = NULL;
+    distinct = NULL;
+  }
+
+  // rank the owners by candidate index; those ranked below n_pairs stay
+  owned = calloc(drawn + 1, sizeof(offset_t));
+  if (owned == NULL) {
+    goto out;
+  }
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < n_vertices; i++) {
+    for (size_t k = 0; k < distinct[i + 1] - distinct[i]; k++) {
+      owned[slots[bucket_index[i] + k].e] = 1;
+    }
+  }
+  exclusive_scan(owned, drawn + 1);
+  // cursor becomes the number of pairs written before each bucket
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < n_vertices; i++) {
+    size_t count = 0;
+    for (size_t k = 0; k < distinct[i + 1] - distinct[i]; k++) {
+      count += owned[slots[bucket_index[i] + k].e] < n_pairs;
+    }
+    cursor[i] = count;
+  }
+  cursor[n_vertices] = 0;
+  exclusive_scan(cursor, n_vertices + 1);
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < n_vertices; i++) {
+    size_t l = cursor[i];
+    for (size_t k = 0; k < distinct[i + 1] - distinct[i]; k++) {
+      const struct random_slot slot = slots[bucket_index[i] + k];
+      if (owned[slot.e] < n_pairs) {
+        pairs[l++] = (struct matrix_al_pair) { .i = i, .j = slot.j };
+      }
+    }
+  }
+  assert(cursor[n_vertices] == n_pairs);
+  status = 0;
+
+out:
+  free(kept);
+  free(slots);
+  free(bucket_index);
+  free(cursor);
+  free(distinct);
+  free(owned);
+  return status;
+}
+
+// Draws n_edges distinct edges uniformly at random in O(n_vertices + n_edges)
+// expected memory, and that time up to sorting each bucket: the first n_edges distinct pairs of a hashed
+// candidate sequence, so the graph only depends on (n_vertices, n_edges), not
+// on the number of threads. Asked for more than half of all pairs, it draws
+// the pairs to leave out instead, so that duplicates stay rare.
+struct matrix *matrix_create_random(const size_t n_vertices, const size_t n_edges) {
+  if (n_vertices > NUMBER_MAX || (n_vertices < 2 ? n_edges > 0 : n_edges > n_vertices * (n_vertices - 1) / 2)) {
+    return NULL;
+  }
+  // nothing to draw, and with no vertices nothing to draw from
+  if (n_edges == 0) {
+    return matrix_create_from_edges(n_vertices, NULL, 0);
+  }
+  const size_t n_all = n_vertices * (n_vertices - 1) / 2;
+  const bool complement = n_edges > n_all / 2;
+  const size_t n_drawn = complement ? n_all - n_edges : n_edges;
+  struct matrix_al_pair *sampled = malloc((n_drawn + 1) * sizeof(struct matrix_al_pair));
+  struct matrix_al_pair *edges = NULL;
+  offset_t *first = NULL;
+  offset_t *start = NULL;
+  struct matrix *m = NULL;
+  if (sampled == NULL || random_distinct_pairs(n_vertices, n_drawn, sampled) != 0) {
+    goto out;
+  }
+  if (!complement) {
+    m = matrix_create_from_edges(n_vertices, sampled, n_edges);
+    goto out;
+  }
+
+  // every pair (i, j > i) but the sampled ones, which are sorted by (i, j);
+  // row i begins at first[i] in sampled and at start[i] in edges
+  edges = malloc(n_edges * sizeof(struct matrix_al_pair));
+  first = calloc(n_vertices + 1, sizeof(offset_t));
+  start = calloc(n_vertices + 1, sizeof(offset_t));
+  if (edges == NULL || first == NULL || start == NULL) {
+    goto out;
+  }
+  for (size_t k = 0; k < n_drawn; k++) {
+    first[sampled[k].i + 1]++;
+  }
+  for (size_t i = 0; i < n_vertices; i++) {
+    first[i + 1] += first[i];
+    start[i] = (n_vertices - 1 - i) - (first[i + 1] - first[i]);
+  }
+  offset_t total = exclusive_scan(start, n_vertices + 1);
+  assert(total == n_edges);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (size_t i = 0; i < n_vertices; i++) {
+    size_t k = first[i];
+    size_t l = start[i];
+    for (size_t j = i + 1; j < n_vertices; j++) {
+      if (k < first[i + 1] && sampled[k].j == j) {
+        k++;
+      } else {
+        edges[l++] = (struct matrix_al_pair) { .i = i, .j = j };
+      }
     }
   }
-  free(am);
+  m = matrix_create_from_edges(n_vertices, edges, n_edges);
+
+out:
+  free(sampled);
+  free(edges);
+  free(first);
+  free(start);
+  if (m == NULL) {
+    return NULL;
+  }
+  assert(m->nnz == 2*n_edges);
   // verify matrix
   for (size_t i = 0; i < m->nnz; i++) {
     assert(m->col_index[i] < m->n_vertices);
   }
   for (size_t i = 0; i < m->n_vertices; i++) {
-    assert(m->row_index[i] < m->nnz);
+    assert(m->row_index[i] <= m->row_index[i + 1]);
   }
   assert(m->row_index[m->n_vertices] == m->nnz);
   return m;
@@ -227,6 +635,11 @@ void matrix_destroy(struct matrix *m) {
   if (m == NULL) {
     return;
   }
+  if (m->mapping != NULL) {
+    munmap(m->mapping, m->mapping_size);
+    free(m);
+    return;
+  }
   if (m->col_index != NULL) {
     free(m->col_index);
   }
@@ -236,6 +649,319 @@ void matrix_destroy(struct matrix *m) {
   free(m);
 }
 
+// === on-disk CSR format ===
+
+size_t matrix_file_col_index_offset(const size_t n_vertices, const size_t row_index_width) {
+  size_t offset = sizeof(struct matrix_file_header) + (n_vertices + 1) * row_index_width;
+  return (offset + 7) & ~(size_t) 7;
+}
+
+bool matrix_file_header_valid(const struct matrix_file_header *header, const size_t file_size) {
+  // divide rather than multiply, so that a bogus header cannot overflow
+  return memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+         header->version == MATRIX_FILE_VERSION &&
+         header->row_index_width == sizeof(offset_t) &&
+         header->col_index_width == sizeof(number_t) &&
+         header->n_vertices <= NUMBER_MAX &&
+         header->n_vertices < file_size / sizeof(offset_t) &&
+         matrix_file_col_index_offset(header->n_vertices, sizeof(offset_t)) <= file_size &&
+         header->nnz <= (file_size - matrix_file_col_index_offset(header->n_vertices, sizeof(offset_t))) / sizeof(number_t);
+}
+
+bool matrix_file_row_index_valid(const offset_t *row_index, const size_t n_vertices, const size_t nnz) {
+  if (row_index[0] != 0 || row_index[n_vertices] != nnz) {
+    return false;
+  }
+  bool valid = true;
+#pragma omp parallel for schedule(static) reduction(&&:valid)
+  for (size_t i = 0; i < n_vertices; i++) {
+    valid = valid && row_index[i] <= row_index[i + 1];
+  }
+  return valid;
+}
+
+int matrix_save(const struct matrix *m, const char *path) {
+  if (m == NULL || path == NULL) {
+    return 1;
+  }
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    return 1;
+  }
+  struct matrix_file_header header = {
+    .version = MATRIX_FILE_VERSION,
+    .row_index_width = sizeof(offset_t),
+    .col_index_width = sizeof(number_t),
+    .n_vertices = m->n_vertices,
+    .nnz = m->nnz,
+  };
+  memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+  const char padding[8] = {0};
+  size_t row_index_end = sizeof(header) + (m->n_vertices + 1) * sizeof(offset_t);
+  size_t padding_size = matrix_file_col_index_offset(m->n_vertices, sizeof(offset_t)) - row_index_end;
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(m->row_index, sizeof(offset_t), m->n_vertices + 1, f) == m->n_vertices + 1 &&
+            fwrite(padding, 1, padding_size, f) == padding_size &&
+            fwrite(m->col_index, sizeof(number_t), m->nnz, f) == m->nnz;
+  if (fclose(f) != 0) {
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
+
+struct matrix *matrix_open_mmap(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct matrix_file_header)) {
+    close(fd);
+    return NULL;
+  }
+  void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+  // the whole graph is streamed by the checks below and by every algorithm,
+  // so let the kernel read ahead
+  madvise(mapping, st.st_size, MADV_WILLNEED);
+
+  // every engine indexes by these offsets and ids, so a corrupt file is
+  // turned away here rather than read out of bounds later
+  const struct matrix_file_header *header = mapping;
+  if (!matrix_file_header_valid(header, st.st_size)) {
+    munmap(mapping, st.st_size);
+    return NULL;
+  }
+  const size_t n = header->n_vertices;
+  const size_t nnz = header->nnz;
+  const size_t col_index_offset = matrix_file_col_index_offset(n, sizeof(offset_t));
+  const offset_t *row_index = (const offset_t *) ((const char *) mapping + sizeof(struct matrix_file_header));
+  const number_t *col_index = (const number_t *) ((const char *) mapping + col_index_offset);
+  bool valid = matrix_file_row_index_valid(row_index, n, nnz);
+#pragma omp parallel for schedule(static) reduction(&&:valid)
+  for (size_t k = 0; k < nnz; k++) {
+    valid = valid && col_index[k] < n;
+  }
+  if (!valid) {
+    munmap(mapping, st.st_size);
+    return NULL;
+  }
+
+  struct matrix *m = malloc(sizeof(struct matrix));
+  if (m == NULL) {
+    munmap(mapping, st.st_size);
+    return NULL;
+  }
+  m->n_vertices = n;
+  m->nnz = nnz;
+  m->row_index = (offset_t *) row_index;
+  m->col_index = (number_t *) col_index;
+  m->mapping = mapping;
+  m->mapping_size = st.st_size;
+  return m;
+}
+
+// === text graph formats ===
+
+static inline bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parses an unsigned decimal integer at p, skipping leading blanks. Returns the
+// position after the number, or NULL if there is none.
+static inline const char *scan_number(const char *p, const char *end, uint64_t *out) {
+  while (p < end && is_blank(*p)) {
+    p++;
+  }
+  if (p == end || (unsigned) (*p - '0') > 9) {
+    return NULL;
+  }
+  uint64_t x = 0;
+  while (p < end && (unsigned) (*p - '0') <= 9) {
+    unsigned digit = *p - '0';
+    if (x > (UINT64_MAX - digit) / 10) {
+      return NULL;
+    }
+    x = x * 10 + digit;
+    p++;
+  }
+  *out = x;
+  return p;
+}
+
+static inline const char *next_line(const char *p, const char *end) {
+  const char *newline = memchr(p, '\n', end - p);
+  return newline == NULL ? end : newline + 1;
+}
+
+// Parses "i j ..." lines in [begin, end) into edges (if not NULL), skipping
+// blank lines and lines starting with comment. Returns the number of edges, or
+// -1 on a malformed line.
+static long long parse_edge_lines(const char *begin, const char *end, char comment, uint64_t base, struct matrix_al_pair *edges, uint64_t *max_vertex) {
+  long long count = 0;
+  for (const char *p = begin; p < end; p = next_line(p, end)) {
+    const char *q = p;
+    while (q < end && is_blank(*q)) {
+      q++;
+    }
+    if (q == end || *q == '\n' || *q == comment) {
+      continue;
+    }
+    uint64_t i, j;
+    q = scan_number(q, end, &i);
+    if (q == NULL) {
+      return -1;
+    }
+    q = scan_number(q, end, &j);
+    if (q == NULL || i < base || j < base) {
+      return -1;
+    }
+    i -= base;
+    j -= base;
+    if (edges != NULL) {
+      edges[count].i = i;
+      edges[count].j = j;
+    }
+    if (i > *max_vertex) {
+      *max_vertex = i;
+    }
+    if (j > *max_vertex) {
+      *max_vertex = j;
+    }
+    count++;
+  }
+  return count;
+}
+
+// Splits [begin, end) into line-aligned chunks, parses them in parallel in two
+// passes (count, then fill at the scanned offsets) and builds the CSR.
+// n_vertices of 0 means one past the largest vertex id seen.
+static struct matrix *matrix_parse_edges(const char *begin, const char *end, char comment, uint64_t base, size_t n_vertices) {
+  const size_t n_chunks = 4 * (size_t) omp_get_max_threads();
+  const char **chunk = malloc((n_chunks + 1) * sizeof(char *));
+  offset_t *offset = calloc(n_chunks + 1, sizeof(offset_t));
+  struct matrix_al_pair *edges = NULL;
+  struct matrix *m = NULL;
+  if (chunk == NULL || offset == NULL) {
+    goto out;
+  }
+  for (size_t c = 0; c <= n_chunks; c++) {
+    const char *p = begin + (end - begin) * c / n_chunks;
+    if (p != begin && p != end && p[-1] != '\n') {
+      p = next_line(p, end);
+    }
+    chunk[c] = p;
+  }
+
+  bool malformed = false;
+  uint64_t max_vertex = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(||:malformed) reduction(max:max_vertex)
+  for (size_t c = 0; c < n_chunks; c++) {
+    long long count = parse_edge_lines(chunk[c], chunk[c + 1], comment, base, NULL, &max_vertex);
+    if (count < 0) {
+      malformed = true;
+    } else {
+      offset[c] = count;
+    }
+  }
+  if (malformed) {
+    goto out;
+  }
+  size_t n_edges = exclusive_scan(offset, n_chunks + 1);
+  if (n_vertices == 0 && n_edges > 0) {
+    n_vertices = max_vertex + 1;
+  }
+  if (n_vertices >= NUMBER_MAX || (n_edges > 0 && max_vertex >= n_vertices)) {
+    goto out;
+  }
+
+  edges = malloc((n_edges > 0 ? n_edges : 1) * sizeof(struct matrix_al_pair));
+  if (edges == NULL) {
+    goto out;
+  }
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t c = 0; c < n_chunks; c++) {
+    uint64_t unused = 0;
+    parse_edge_lines(chunk[c], chunk[c + 1], comment, base, edges + offset[c], &unused);
+  }
+  m = matrix_create_from_edges(n_vertices, edges, n_edges);
+
+out:
+  free(chunk);
+  free(offset);
+  free(edges);
+  return m;
+}
+
+// Parses a Matrix Market coordinate file. Values (if any) are ignored, and
+// both general and symmetric files give the same symmetric graph.
+static struct matrix *matrix_parse_mtx(const char *begin, const char *end) {
+  const char *p = next_line(begin, end);
+  size_t header_length = p - begin;
+  const char *coordinate = "coordinate";
+  bool is_coordinate = false;
+  for (size_t k = 0; k + strlen(coordinate) <= header_length; k++) {
+    if (strncasecmp(begin + k, coordinate, strlen(coordinate)) == 0) {
+      is_coordinate = true;
+      break;
+    }
+  }
+  if (!is_coordinate) {
+    return NULL;
+  }
+  // skip comments up to the size line
+  while (p < end && *p == '%') {
+    p = next_line(p, end);
+  }
+  uint64_t rows, cols, entries;
+  const char *q = scan_number(p, end, &rows);
+  if (q == NULL || (q = scan_number(q, end, &cols)) == NULL || scan_number(q, end, &entries) == NULL) {
+    return NULL;
+  }
+  // vertex ids are narrowed to number_t, and NUMBER_MAX vertices would not
+  // leave room for the n_vertices + 1 row offsets with 64-bit ids
+  if (rows >= NUMBER_MAX || cols >= NUMBER_MAX) {
+    return NULL;
+  }
+  return matrix_parse_edges(next_line(p, end), end, '%', 1, rows > cols ? rows : cols);
+}
+
+struct matrix *matrix_load(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    return NULL;
+  }
+  const char *end = text + st.st_size;
+
+  struct matrix *m;
+  const char *mtx_banner = "%%MatrixMarket";
+  if ((size_t) st.st_size >= strlen(MATRIX_FILE_MAGIC) && memcmp(text, MATRIX_FILE_MAGIC, strlen(MATRIX_FILE_MAGIC)) == 0) {
+    munmap(text, st.st_size);
+    return matrix_open_mmap(path);
+  } else if ((size_t) st.st_size >= strlen(mtx_banner) && memcmp(text, mtx_banner, strlen(mtx_banner)) == 0) {
+    madvise(text, st.st_size, MADV_SEQUENTIAL);
+    m = matrix_parse_mtx(text, end);
+  } else {
+    madvise(text, st.st_size, MADV_SEQUENTIAL);
+    m = matrix_parse_edges(text, end, '#', 0, 0);
+  }
+  munmap(text, st.st_size);
+  return m;
+}
+
 void matrix_print(const struct matrix *m) {
   if (m == NULL) {
     return;
@@ -264,7 +990,7 @@ void matrix_as_dot(const struct matrix *m, FILE *f) {
   fprintf(f, "graph G {\n");
   for (size_t i = 0; i < m->n_vertices; i++) {
     for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
-      fprintf(f, "  %lu -- %lu;\n", i, m->col_index[j]);
+      fprintf(f, "  %zu -- %" PRInumber ";\n", i, m->col_index[j]);
     }
   }
   fprintf(f, "}\n");
@@ -274,17 +1000,18 @@ bool matrix_query(const struct matrix *m, number_t i, number_t j) {
   if (m == NULL) {
     return false;
   }
-  if (i > j) {
-    number_t tmp = i;
-    i = j;
-    j = tmp;
-  }
-  for (size_t k = m->row_index[i]; k < m->row_index[i + 1]; k++) {
-    if (m->col_index[k] == j) {
-      return true;
+  // rows are sorted (matrix_create_from_edges guarantees it)
+  size_t lo = m->row_index[i];
+  size_t hi = m->row_index[i + 1];
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (m->col_index[mid] < j) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
   }
-  return false;
+  return lo < m->row_index[i + 1] && m->col_index[lo] == j;
 }
 
 bool matrix_verify_coloring(const struct matrix *m, const struct coloring *c, const bool ignore_zero) {
@@ -292,9 +1019,9 @@ bool matrix_verify_coloring(const struct matrix *m, const struct coloring *c, co
     for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
       if (c->colors[i] == c->colors[m->col_index[j]] && (!ignore_zero || c->colors[i] != 0)) {
         if (c->colors[i] == 0) {
-          printf("Uncolored vertex %lu\n", i);
+          printf("Uncolored vertex %zu\n", i);
         } else {
-          printf("Invalid coloring at (%lu, %lu)\n", i, m->col_index[j]);
+          printf("Invalid coloring at (%zu, %" PRInumber ")\n", i, m->col_index[j]);
         }
         return false;
       }
@@ -303,76 +1030,112 @@ bool matrix_verify_coloring(const struct matrix *m, const struct coloring *c, co
   return true;
 }
 
-struct matrix *matrix_induce(const struct matrix *m, const bool *take, number_t *new_vertex_out) {
+bool matrix_verify_distance2_coloring(const struct matrix *m, const struct coloring *c) {
+  if (!matrix_verify_coloring(m, c, false)) {
+    return false;
+  }
+  // every two vertices within distance 2 are adjacent or share a neighbor,
+  // so it suffices that the neighbors of each vertex have distinct colors;
+  // seen[color] holds the last vertex whose neighborhood had that color
+  color_t max_color = coloring_max_color(c);
+  number_t *seen = malloc(((size_t) max_color + 1) * sizeof(number_t));
+  if (seen == NULL) {
+    return false;
+  }
+  for (size_t color = 0; color <= max_color; color++) {
+    seen[color] = NUMBER_MAX;
+  }
+  bool valid = true;
+  for (size_t i = 0; i < m->n_vertices && valid; i++) {
+    for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
+      number_t v = m->col_index[j];
+      if (seen[c->colors[v]] == i) {
+        printf("Invalid distance-2 coloring around %zu: color %" PRIcolor "\n", i, c->colors[v]);
+        valid = false;
+        break;
+      }
+      seen[c->colors[v]] = i;
+    }
+  }
+  free(seen);
+  return valid;
+}
+
+color_t coloring_max_color(const struct coloring *c) {
+  color_t max_color = 0;
+#pragma omp parallel for schedule(static) reduction(max:max_color)
+  for (size_t i = 0; i < c->colors_size; i++) {
+    if (c->colors[i] > max_color) {
+      max_color = c->colors[i];
+    }
+  }
+  return max_color;
+}
+
+struct matrix *matrix_induce(const struct matrix *m, const uint64_t *take, number_t *new_vertex_out, number_t *old_vertex_out) {
   if (m == NULL || take == NULL) {
     return NULL;
   }
 
-  // === prepare n_vertices and nnz of induced matrix ===
-  size_t induced_n_vertices = 0;
+  // relabel: new ids are the ranks of the taken vertices, which keeps the
+  // relative order (and so rows stay sorted)
+  offset_t *rank = malloc((m->n_vertices + 1) * sizeof(offset_t));
+  if (rank == NULL) {
+    return NULL;
+  }
+#pragma omp parallel for
   for (size_t i = 0; i < m->n_vertices; i++) {
-    if (take[i]) {
-      new_vertex_out[i] = induced_n_vertices++;
+    rank[i] = vset_test(take, i);
+  }
+  rank[m->n_vertices] = 0;
+  size_t induced_n_vertices = exclusive_scan(rank, m->n_vertices + 1);
+#pragma omp parallel for
+  for (size_t i = 0; i < m->n_vertices; i++) {
+    if (vset_test(take, i)) {
+      new_vertex_out[i] = rank[i];
+      old_vertex_out[rank[i]] = i;
     } else {
       new_vertex_out[i] = -1;
     }
   }
-  // to get nnz, count edges that have both ends in take
-  size_t induced_nnz = 0;
-  number_t *edge_count_per_row = calloc(m->n_vertices, sizeof(number_t));
-  if (edge_count_per_row == NULL) {
+  free(rank);
+
+  // pass 1: count the kept entries of each induced row
+  offset_t *row_index = calloc(induced_n_vertices + 1, sizeof(offset_t));
+  if (row_index == NULL) {
     return NULL;
   }
-  for (size_t i = 0; i < m->n_vertices; i++) {
-    for (size_t j = m->row_index[i]; j < m->row_index[i+1]; j++) {
-      if (take[i] && take[m->col_index[j]]) {
-        induced_nnz++;
-        edge_count_per_row[i]++;
-      }
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t u = 0; u < induced_n_vertices; u++) {
+    offset_t count = 0;
+    for (size_t j = m->row_index[old_vertex_out[u]]; j < m->row_index[old_vertex_out[u] + 1]; j++) {
+      number_t v = m->col_index[j];
+      count += vset_test(take, v);
     }
+    row_index[u] = count;
   }
+  size_t induced_nnz = exclusive_scan(row_index, induced_n_vertices + 1);
 
-  // === create and fill induced matrix ===
   struct matrix *induced = matrix_create(induced_n_vertices, induced_nnz);
   if (induced == NULL) {
-    free(edge_count_per_row);
+    free(row_index);
     return NULL;
   }
+  free(induced->row_index);
+  induced->row_index = row_index;
 
-  // fill row_index
-  {
-    size_t total_nz = 0;
-    for (size_t i = 0, j = 0; i < m->n_vertices; i++) {
-      if (take[i]) {
-        induced->row_index[j] = total_nz;
-        total_nz += edge_count_per_row[i];
-        j++;
+  // pass 2: fill them, in both orientations since every row is visited
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t u = 0; u < induced_n_vertices; u++) {
+    size_t k = induced->row_index[u];
+    for (size_t j = m->row_index[old_vertex_out[u]]; j < m->row_index[old_vertex_out[u] + 1]; j++) {
+      number_t v = m->col_index[j];
+      if (vset_test(take, v)) {
+        induced->col_index[k++] = new_vertex_out[v];
       }
     }
+    assert(k == induced->row_index[u + 1]);
   }
-
-  // fill col_index
-  for (size_t i = 0; i < m->n_vertices; i++) {
-    if (take[i]) {
-      for (size_t j = m->row_index[i]; j < m->row_index[i+1]; j++) {
-        number_t old_destination = m->col_index[j];
-        if (!take[old_destination]) {
-          continue;
-        }
-        number_t new_destination = new_vertex_out[old_destination];
-        number_t new_source = new_vertex_out[i];
-        if (new_source >= new_destination) {
-          number_t tmp = new_source;
-          new_source = new_destination;
-          new_destination = tmp;
-        }
-        assert(edge_count_per_row[i] > 0);
-        induced->col_index[induced->row_index[new_source] + edge_count_per_row[i] - 1] = new_destination;
-        edge_count_per_row[i]--;
-      }
-    }
-  }
-  free(edge_count_per_row);
   return induced;
 }
 
@@ -394,45 +1157,419 @@ void matrix_degree(const struct matrix *m, size_t *degree) {
   }
 }
 
-struct matrix *matrix_select(const struct matrix *m, const bool *select) {
+struct matrix *matrix_select(const struct matrix *m, const uint64_t *select) {
   assert(m != NULL);
   assert(select != NULL);
 
-  size_t selected_nnz = 0;
-  // iterate all edges and count selected edges (i.e. have selected vertices on both ends)
-
+  // pass 1: count the kept entries of each row
+  offset_t *row_index = calloc(m->n_vertices + 1, sizeof(offset_t));
+  if (row_index == NULL) {
+    return NULL;
+  }
+#pragma omp parallel for schedule(static)
   for (size_t i = 0; i < m->n_vertices; i++) {
+    if (!vset_test(select, i)) {
+      continue;
+    }
+    offset_t count = 0;
     for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
-      size_t u = i;
-      size_t v = m->col_index[j];
-      if (select[u] && select[v] && matrix_query(m, u, v)) {
-        selected_nnz++;
-      }
+      number_t v = m->col_index[j];
+      count += vset_test(select, v);
     }
+    row_index[i] = count;
   }
+  size_t selected_nnz = exclusive_scan(row_index, m->n_vertices + 1);
 
   struct matrix *m2 = matrix_create(m->n_vertices, selected_nnz);
   if (m2 == NULL) {
+    free(row_index);
     return NULL;
   }
+  free(m2->row_index);
+  m2->row_index = row_index;
 
-  {
-    size_t total_nz = 0;
-    for (size_t i = 0; i < m2->n_vertices; i++) {
-      m2->row_index[i] = total_nz;
-      for (size_t j = 0; j < m->n_vertices; j++) {
-        if (select[i] && select[j] && matrix_query(m, i, j)) {
-          m2->col_index[total_nz] = j;
-          total_nz++;
-        }
+  // pass 2: copy them; source rows are sorted, so these are too
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < m->n_vertices; i++) {
+    if (!vset_test(select, i)) {
+      continue;
+    }
+    size_t k = m2->row_index[i];
+    for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
+      number_t v = m->col_index[j];
+      if (vset_test(select, v)) {
+        m2->col_index[k++] = v;
       }
     }
-    assert(total_nz == selected_nnz);
+    assert(k == m2->row_index[i + 1]);
   }
 
   return m2;
 }
 
+// === degeneracy ===
+
+size_t matrix_degeneracy_order(const struct matrix *m, number_t *order, number_t *core) {
+  const size_t n = m->n_vertices;
+  offset_t *d = malloc(n * sizeof(offset_t));
+  number_t *remaining = malloc(n * sizeof(number_t));
+  offset_t *position = malloc((n + 1) * sizeof(offset_t));
+  uint64_t *removed = vset_create(n);
+  assert(d != NULL && remaining != NULL && position != NULL && removed != NULL);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++) {
+    d[i] = m->row_index[i + 1] - m->row_index[i];
+    remaining[i] = i;
+  }
+  size_t n_remaining = n;
+
+  // order doubles as the queue: order[0..placed) is peeled, order[placed..end)
+  // is the frontier being peeled and order[end..tail) the next frontier
+  size_t placed = 0;
+  size_t k = 0;
+  while (placed < n) {
+    // drop the peeled vertices from remaining, and move k up to the smallest
+    // remaining degree
+    offset_t min_d = OFFSET_MAX;
+#pragma omp parallel for schedule(static) reduction(min:min_d)
+    for (size_t a = 0; a < n_remaining; a++) {
+      number_t v = remaining[a];
+      position[a] = !vset_test(removed, v);
+      if (position[a] && d[v] < min_d) {
+        min_d = d[v];
+      }
+    }
+    position[n_remaining] = 0;
+    exclusive_scan(position, n_remaining + 1);
+    size_t kept = 0;
+    for (size_t a = 0; a < n_remaining; a++) {
+      if (position[a + 1] != position[a]) {
+        remaining[kept++] = remaining[a];
+      }
+    }
+    n_remaining = kept;
+    if (min_d > k) {
+      k = min_d;
+    }
+
+    // the frontier starts as every remaining vertex of degree <= k
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_remaining; a++) {
+      position[a] = d[remaining[a]] <= k;
+    }
+    position[n_remaining] = 0;
+    size_t end = placed + exclusive_scan(position, n_remaining + 1);
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_remaining; a++) {
+      if (position[a + 1] != position[a]) {
+        order[placed + position[a]] = remaining[a];
+      }
+    }
+
+    while (placed < end) {
+#pragma omp parallel for schedule(static)
+      for (size_t a = placed; a < end; a++) {
+        vset_add_atomic(removed, order[a]);
+        if (core != NULL) {
+          core[order[a]] = k;
+        }
+      }
+      // a neighbor joins the next frontier when its degree drops to k, which
+      // happens exactly once
+      size_t tail = end;
+#pragma omp parallel for schedule(dynamic, 256)
+      for (size_t a = placed; a < end; a++) {
+        for (size_t j = m->row_index[order[a]]; j < m->row_index[order[a] + 1]; j++) {
+          number_t v = m->col_index[j];
+          if (!vset_test(removed, v) && __atomic_sub_fetch(&d[v], 1, __ATOMIC_RELAXED) == k) {
+            order[__atomic_fetch_add(&tail, 1, __ATOMIC_RELAXED)] = v;
+          }
+        }
+      }
+      // the slots were taken in thread order; sort them for a deterministic order
+      qsort(order + end, tail - end, sizeof(number_t), number_compar);
+      placed = end;
+      end = tail;
+    }
+  }
+
+  free(d);
+  free(remaining);
+  free(position);
+  free(removed);
+  return k;
+}
+
+// === chordality ===
+// Cite: Tarjan and Yannakakis, "Simple linear-time algorithms to test
+// chordality of graphs, test acyclicity of hypergraphs, and selectively
+// reduce acyclic hypergraphs", SIAM J. Comput. 13(3), 1984
+
+void matrix_mcs_order(const struct matrix *m, number_t *order) {
+  const size_t n = m->n_vertices;
+  // unvisited vertices sit in doubly linked buckets by their number of
+  // visited neighbors
+  number_t *weight = calloc(n, sizeof(number_t));
+  number_t *next = malloc(n * sizeof(number_t));
+  number_t *prev = malloc(n * sizeof(number_t));
+  number_t *head = malloc((n + 1) * sizeof(number_t));
+  uint64_t *visited = vset_create(n);
+  assert(weight != NULL && next != NULL && prev != NULL && head != NULL && visited != NULL);
+  for (size_t w = 0; w <= n; w++) {
+    head[w] = NUMBER_MAX;
+  }
+  for (size_t v = n; v-- > 0;) {
+    next[v] = head[0];
+    prev[v] = NUMBER_MAX;
+    if (head[0] != NUMBER_MAX) {
+      prev[head[0]] = v;
+    }
+    head[0] = v;
+  }
+
+  size_t max_weight = 0;
+  for (size_t i = 0; i < n; i++) {
+    while (head[max_weight] == NUMBER_MAX) {
+      max_weight--;
+    }
+    number_t v = head[max_weight];
+    head[max_weight] = next[v];
+    if (next[v] != NUMBER_MAX) {
+      prev[next[v]] = NUMBER_MAX;
+    }
+    vset_add(visited, v);
+    order[i] = v;
+
+    for (size_t j = m->row_index[v]; j < m->row_index[v + 1]; j++) {
+      number_t u = m->col_index[j];
+      if (vset_test(visited, u)) {
+        continue;
+      }
+      // unlink u from its bucket and push it onto the next one
+      if (prev[u] != NUMBER_MAX) {
+        next[prev[u]] = next[u];
+      } else {
+        head[weight[u]] = next[u];
+      }
+      if (next[u] != NUMBER_MAX) {
+        prev[next[u]] = prev[u];
+      }
+      weight[u]++;
+      next[u] = head[weight[u]];
+      prev[u] = NUMBER_MAX;
+      if (head[weight[u]] != NUMBER_MAX) {
+        prev[head[weight[u]]] = u;
+      }
+      head[weight[u]] = u;
+      if (weight[u] > max_weight) {
+        max_weight = weight[u];
+      }
+    }
+  }
+
+  free(weight);
+  free(next);
+  free(prev);
+  free(head);
+  free(visited);
+}
+
+bool matrix_is_reverse_peo(const struct matrix *m, const number_t *order) {
+  const size_t n = m->n_vertices;
+  number_t *position = malloc(n * sizeof(number_t));
+  assert(position != NULL);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++) {
+    position[order[i]] = i;
+  }
+  // The earlier neighbors of v form a clique iff each of them is adjacent to
+  // the latest of them (its parent), given the same holds for the parent.
+  bool ok = true;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(&&:ok)
+  for (size_t v = 0; v < n; v++) {
+    number_t parent = NUMBER_MAX;
+    for (size_t j = m->row_index[v]; j < m->row_index[v + 1]; j++) {
+      number_t u = m->col_index[j];
+      if (position[u] < position[v] && (parent == NUMBER_MAX || position[u] > position[parent])) {
+        parent = u;
+      }
+    }
+    if (parent == NUMBER_MAX) {
+      continue;
+    }
+    for (size_t j = m->row_index[v]; j < m->row_index[v + 1]; j++) {
+      number_t u = m->col_index[j];
+      if (position[u] < position[parent] && !matrix_query(m, parent, u)) {
+        ok = false;
+        break;
+      }
+    }
+  }
+  free(position);
+  return ok;
+}
+
+// === vertex reordering ===
+
+struct matrix *matrix_permute(const struct matrix *m, const number_t *perm) {
+  number_t *inverse = malloc(m->n_vertices * sizeof(number_t));
+  offset_t *row_index = malloc((m->n_vertices + 1) * sizeof(offset_t));
+  if (inverse == NULL || row_index == NULL) {
+    free(inverse);
+    free(row_index);
+    return NULL;
+  }
+#pragma omp parallel for
+  for (size_t u = 0; u < m->n_vertices; u++) {
+    inverse[perm[u]] = u;
+    row_index[u] = m->row_index[perm[u] + 1] - m->row_index[perm[u]];
+  }
+  row_index[m->n_vertices] = 0;
+  exclusive_scan(row_index, m->n_vertices + 1);
+
+  struct matrix *permuted = matrix_create(m->n_vertices, m->nnz);
+  if (permuted == NULL) {
+    free(inverse);
+    free(row_index);
+    return NULL;
+  }
+  free(permuted->row_index);
+  permuted->row_index = row_index;
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t u = 0; u < m->n_vertices; u++) {
+    size_t k = permuted->row_index[u];
+    for (size_t j = m->row_index[perm[u]]; j < m->row_index[perm[u] + 1]; j++) {
+      number_t v = m->col_index[j];
+      permuted->col_index[k++] = inverse[v];
+    }
+    sort_row(permuted->col_index + permuted->row_index[u], k - permuted->row_index[u]);
+  }
+  free(inverse);
+  return permuted;
+}
+
+void coloring_unpermute(const struct coloring *permuted, const number_t *perm, struct coloring *original) {
+  assert(permuted->colors_size == original->colors_size);
+#pragma omp parallel for
+  for (size_t u = 0; u < permuted->colors_size; u++) {
+    original->colors[perm[u]] = permuted->colors[u];
+  }
+}
+
+// Counting sort of the vertices by degree (stable, so ties keep id order).
+static void order_by_degree(const struct matrix *m, number_t *order, const bool descending) {
+  size_t max_degree = 0;
+  for (size_t i = 0; i < m->n_vertices; i++) {
+    size_t degree = m->row_index[i + 1] - m->row_index[i];
+    if (degree > max_degree) {
+      max_degree = degree;
+    }
+  }
+  offset_t *bucket = calloc(max_degree + 2, sizeof(offset_t));
+  assert(bucket != NULL);
+  for (size_t i = 0; i < m->n_vertices; i++) {
+    size_t degree = m->row_index[i + 1] - m->row_index[i];
+    bucket[descending ? max_degree - degree : degree]++;
+  }
+  exclusive_scan(bucket, max_degree + 2);
+  for (size_t i = 0; i < m->n_vertices; i++) {
+    size_t degree = m->row_index[i + 1] - m->row_index[i];
+    order[bucket[descending ? max_degree - degree : degree]++] = i;
+  }
+  free(bucket);
+}
+
+// Breadth-first order over all components. Each component starts from the
+// first unvisited vertex of starts. If by_degree, the unvisited neighbors of
+// a vertex are enqueued by ascending degree (Cuthill-McKee), otherwise by id.
+static void order_breadth_first(const struct matrix *m, const number_t *starts, number_t *order, const bool by_degree) {
+  bool *visited = calloc(m->n_vertices, sizeof(bool));
+  assert(visited != NULL);
+  size_t head = 0;
+  size_t tail = 0;
+  for (size_t s = 0; s < m->n_vertices; s++) {
+    if (visited[starts[s]]) {
+      continue;
+    }
+    visited[starts[s]] = true;
+    order[tail++] = starts[s];
+    while (head < tail) {
+      number_t u = order[head++];
+      size_t first = tail;
+      for (size_t j = m->row_index[u]; j < m->row_index[u + 1]; j++) {
+        number_t v = m->col_index[j];
+        if (!visited[v]) {
+          visited[v] = true;
+          order[tail++] = v;
+        }
+      }
+      if (!by_degree) {
+        continue;
+      }
+      // insertion sort of the newly enqueued vertices by (degree, id)
+      for (size_t a = first + 1; a < tail; a++) {
+        number_t x = order[a];
+        offset_t x_degree = m->row_index[x + 1] - m->row_index[x];
+        size_t b = a;
+        while (b > first) {
+          number_t y = order[b - 1];
+          offset_t y_degree = m->row_index[y + 1] - m->row_index[y];
+          if (y_degree < x_degree || (y_degree == x_degree && y < x)) {
+            break;
+          }
+          order[b] = y;
+          b--;
+        }
+        order[b] = x;
+      }
+    }
+  }
+  assert(tail == m->n_vertices);
+  free(visited);
+}
+
+struct matrix *matrix_reorder(const struct matrix *m, const enum matrix_order order, number_t *perm) {
+  if (m == NULL || perm == NULL) {
+    return NULL;
+  }
+  switch (order) {
+  case MATRIX_ORDER_DEGREE:
+    order_by_degree(m, perm, true);
+    break;
+  case MATRIX_ORDER_BFS: {
+    number_t *starts = malloc(m->n_vertices * sizeof(number_t));
+    if (starts == NULL) {
+      return NULL;
+    }
+    for (size_t i = 0; i < m->n_vertices; i++) {
+      starts[i] = i;
+    }
+    order_breadth_first(m, starts, perm, false);
+    free(starts);
+    break;
+  }
+  case MATRIX_ORDER_RCM: {
+    // each component starts from its lowest-degree vertex
+    number_t *starts = malloc(m->n_vertices * sizeof(number_t));
+    if (starts == NULL) {
+      return NULL;
+    }
+    order_by_degree(m, starts, false);
+    order_breadth_first(m, starts, perm, true);
+    free(starts);
+    for (size_t a = 0, b = m->n_vertices; a + 1 < b; a++, b--) {
+      number_t tmp = perm[a];
+      perm[a] = perm[b - 1];
+      perm[b - 1] = tmp;
+    }
+    break;
+  }
+  default:
+    return NULL;
+  }
+  return matrix_permute(m, perm);
+}
+
 void matrix_as_dot_subgraph_color(const struct matrix *m, FILE *f, const struct subgraph *subgraphs, const size_t subgraphs_length, const struct coloring *c) {
   if (m == NULL || f == NULL || subgraphs == NULL || subgraphs_length <= 0 || c == NULL) {
     return;
@@ -441,17 +1578,17 @@ void matrix_as_dot_subgraph_color(const struct matrix *m, FILE *f, const struct
   for (size_t subgraph_index = 0; subgraph_index < subgraphs_length; subgraph_index++) {
     fprintf(f, "  subgraph cluster_%zu {\n", subgraph_index);
     for (size_t i = 0; i < m->n_vertices; i++) {
-      if (!subgraphs[subgraph_index].vertices[i]) {
+      if (!vset_test(subgraphs[subgraph_index].vertices, i)) {
         continue;
       }
       if (c->colors[i] < color_names_length) {
-        fprintf(f, "    %lu [color=%s];\n", i, color_names[c->colors[i]]);
+        fprintf(f, "    %zu [color=%s];\n", i, color_names[c->colors[i]]);
       }
       for (size_t j = m->row_index[i]; j < m->row_index[i + 1]; j++) {
         if (i >= m->col_index[j]) {
           continue;
         }
-        fprintf(f, "    %lu -- %lu;\n", i, m->col_index[j]);
+        fprintf(f, "    %zu -- %" PRInumber ";\n", i, m->col_index[j]);
       }
     }
     fprintf(f, "  }\n");
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -7,9 +8,118 @@
 
 #include "mpi.h"
 
+// Index widths are chosen at compile time (the Makefile passes these):
+// - NUMBER_BITS: vertex ids, i.e. col_index entries (32 or 64)
+// - OFFSET_BITS: row_index entries, i.e. edge offsets (32 or 64)
+// - COLOR_BITS:  color ids (8, 16, 32 or 64)
+#ifndef NUMBER_BITS
+#define NUMBER_BITS 32
+#endif
+#ifndef OFFSET_BITS
+#define OFFSET_BITS 64
+#endif
+#ifndef COLOR_BITS
+#define COLOR_BITS 16
+#endif
+
+#if NUMBER_BITS == 32
+#define number_t uint32_t
+#define NUMBER_T_MPI MPI_UINT32_T
+#define PRInumber PRIu32
+#elif NUMBER_BITS == 64
 #define number_t uint64_t
 #define NUMBER_T_MPI MPI_UINT64_T
+#define PRInumber PRIu64
+#else
+#error "NUMBER_BITS must be 32 or 64"
+#endif
 #define number_bits (sizeof(number_t) * 8)
+#define NUMBER_MAX ((number_t) -1)
+
+#if OFFSET_BITS == 32
+#define offset_t uint32_t
+#define OFFSET_T_MPI MPI_UINT32_T
+#define PRIoffset PRIu32
+#elif OFFSET_BITS == 64
+#define offset_t uint64_t
+#define OFFSET_T_MPI MPI_UINT64_T
+#define PRIoffset PRIu64
+#else
+#error "OFFSET_BITS must be 32 or 64"
+#endif
+#define OFFSET_MAX ((offset_t) -1)
+
+#if COLOR_BITS == 8
+#define color_t uint8_t
+#define COLOR_T_MPI MPI_UINT8_T
+#define PRIcolor PRIu8
+#elif COLOR_BITS == 16
+#define color_t uint16_t
+#define COLOR_T_MPI MPI_UINT16_T
+#define PRIcolor PRIu16
+#elif COLOR_BITS == 32
+#define color_t uint32_t
+#define COLOR_T_MPI MPI_UINT32_T
+#define PRIcolor PRIu32
+#elif COLOR_BITS == 64
+#define color_t uint64_t
+#define COLOR_T_MPI MPI_UINT64_T
+#define PRIcolor PRIu64
+#else
+#error "COLOR_BITS must be 8, 16, 32 or 64"
+#endif
+#define COLOR_MAX ((color_t) -1)
+
+// SplitMix64 finalizer: maps a counter to a well-mixed 64-bit value, so each
+// random draw (a candidate edge, a vertex in a Luby round) is independent of
+// every other and of the thread that makes it.
+static inline uint64_t hash64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Vertex sets are bitsets, one bit per vertex packed into 64-bit words
+// (vertex i is bit i % 64 of word i / 64). Bits past the last vertex stay 0.
+#define VSET_WORD_BITS 64
+#define VSET_WORDS(n) (((n) + VSET_WORD_BITS - 1) / VSET_WORD_BITS)
+
+// Returns an empty set with room for n vertices, or NULL.
+uint64_t *vset_create(const size_t n);
+
+static inline bool vset_test(const uint64_t *s, const size_t i) {
+  return (s[i / VSET_WORD_BITS] >> (i % VSET_WORD_BITS)) & 1;
+}
+
+static inline void vset_add(uint64_t *s, const size_t i) {
+  s[i / VSET_WORD_BITS] |= (uint64_t) 1 << (i % VSET_WORD_BITS);
+}
+
+static inline void vset_remove(uint64_t *s, const size_t i) {
+  s[i / VSET_WORD_BITS] &= ~((uint64_t) 1 << (i % VSET_WORD_BITS));
+}
+
+// For sets that other threads write to at the same time (the plain versions
+// would lose the other bits of the word).
+static inline void vset_add_atomic(uint64_t *s, const size_t i) {
+  __atomic_fetch_or(&s[i / VSET_WORD_BITS], (uint64_t) 1 << (i % VSET_WORD_BITS), __ATOMIC_RELAXED);
+}
+
+static inline void vset_remove_atomic(uint64_t *s, const size_t i) {
+  __atomic_fetch_and(&s[i / VSET_WORD_BITS], ~((uint64_t) 1 << (i % VSET_WORD_BITS)), __ATOMIC_RELAXED);
+}
+
+// a |= b, over sets of n vertices
+void vset_union(uint64_t *a, const uint64_t *b, const size_t n);
+
+// a &= ~b, over sets of n vertices
+void vset_difference(uint64_t *a, const uint64_t *b, const size_t n);
+
+size_t vset_count(const uint64_t *s, const size_t n);
+
+// In-place parallel exclusive prefix sum of a[0..n); returns the total.
+offset_t exclusive_scan(offset_t *a, const size_t n);
 
 // Note that this pair only has (i, j) where i < j
 struct matrix_al_pair {
@@ -38,7 +148,7 @@ bool matrix_al_query(struct matrix_al *m, number_t i, number_t j);
 void matrix_al_fill_random(struct matrix_al *m);
 
 struct coloring {
-  number_t *colors; // note that zero is not a color, but a marker for uncolored
+  color_t *colors; // note that zero is not a color, but a marker for uncolored
   size_t colors_size;
 };
 
@@ -48,15 +158,68 @@ struct matrix {
   size_t n_vertices;
   size_t nnz;
   number_t *col_index;  // nnz elements
-  number_t *row_index;  // n_vertices + 1 elements
+  offset_t *row_index;  // n_vertices + 1 elements
+  void *mapping;        // non-NULL iff col_index and row_index point into a read-only file mapping
+  size_t mapping_size;
+};
+
+// On-disk CSR format (native byte order):
+//   struct matrix_file_header
+//   row_index: n_vertices + 1 entries of row_index_width bytes
+//   padding up to a multiple of 8 bytes
+//   col_index: nnz entries of col_index_width bytes
+#define MATRIX_FILE_MAGIC "PCSRGRPH"
+#define MATRIX_FILE_VERSION 1
+
+struct matrix_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t row_index_width;
+  uint32_t col_index_width;
+  uint32_t reserved;
+  uint64_t n_vertices;
+  uint64_t nnz;
 };
 
 struct matrix *matrix_create(const size_t n_vertices, const size_t nnz);
 
 struct matrix *matrix_create_random(const size_t n_vertices, const size_t nnz);
 
+// Builds a symmetric CSR with sorted, duplicate-free rows from an unsorted
+// edge list. Either orientation of an edge may be given (or both); duplicates
+// and self-loops are dropped.
+struct matrix *matrix_create_from_edges(const size_t n_vertices, const struct matrix_al_pair *edges, const size_t n_edges);
+
 void matrix_destroy(struct matrix *m);
 
+// Returns the byte offset of col_index in the on-disk CSR format for a graph
+// of n_vertices whose row offsets are row_index_width bytes wide.
+size_t matrix_file_col_index_offset(const size_t n_vertices, const size_t row_index_width);
+
+// Returns whether header matches this build and the row offsets and column
+// ids it announces fit in a file of file_size bytes.
+bool matrix_file_header_valid(const struct matrix_file_header *header, const size_t file_size);
+
+// Returns whether the n_vertices + 1 row offsets start at 0, never go back
+// and end at nnz.
+bool matrix_file_row_index_valid(const offset_t *row_index, const size_t n_vertices, const size_t nnz);
+
+// Writes m in the on-disk CSR format. Returns 0 on success.
+int matrix_save(const struct matrix *m, const char *path);
+
+// Maps a file written by matrix_save read-only, without copying. The page
+// cache is shared between processes mapping the same file. Returns NULL if the
+// file cannot be mapped, its header does not match this build or the file,
+// its row offsets are not valid, or a column id is not below n_vertices.
+struct matrix *matrix_open_mmap(const char *path);
+
+// Loads a graph from a file written by matrix_save (mapped with
+// matrix_open_mmap), a Matrix Market coordinate file (.mtx, 1-based), or a
+// whitespace-separated edge list (SNAP style, 0-based, '#' comments).
+// Text files are mapped and parsed in parallel chunks straight into
+// matrix_create_from_edges. Returns NULL on error.
+struct matrix *matrix_load(const char *path);
+
 void matrix_print(const struct matrix *m);
 
 void matrix_as_dot(const struct matrix *m, FILE *f);
@@ -67,16 +230,64 @@ bool matrix_query(const struct matrix *m, const number_t i, const number_t j);
 
 bool matrix_verify_coloring(const struct matrix *m, const struct coloring *c, const bool ignore_zero);
 
-struct matrix *matrix_induce(const struct matrix *m, const bool *take, number_t *new_vertex_out);
+// Checks that vertices within distance 2 have different colors, i.e. that c
+// is a complete distance-1 coloring and every neighborhood is rainbow.
+bool matrix_verify_distance2_coloring(const struct matrix *m, const struct coloring *c);
+
+// Returns the largest color used, i.e. the number of colors if they are 1..k.
+color_t coloring_max_color(const struct coloring *c);
+
+// Returns the subgraph induced by the vertices in the set take, relabeled
+// 0..n'-1 in their original order. new_vertex_out[old] is the new id (or -1
+// if not taken) and old_vertex_out[new] the old id; both must have room for
+// m->n_vertices entries.
+struct matrix *matrix_induce(const struct matrix *m, const uint64_t *take, number_t *new_vertex_out, number_t *old_vertex_out);
 
 void matrix_iterate_edges(const struct matrix *m, const void (*f)(number_t, number_t, void *), void *data);
 
 void matrix_degree(const struct matrix *m, size_t *degree);
 
-struct matrix *matrix_select(const struct matrix *m, const bool *select);
+struct matrix *matrix_select(const struct matrix *m, const uint64_t *select);
+
+// Peels m by k-cores in parallel: each round removes every vertex with at
+// most k remaining neighbors, and k rises only when none are left. order
+// receives the vertices in removal order (n_vertices entries; its reverse is
+// a smallest-last order) and core, if not NULL, the core number of each
+// vertex. Returns the degeneracy, i.e. the largest core number; coloring
+// greedily in reverse removal order needs at most degeneracy + 1 colors.
+size_t matrix_degeneracy_order(const struct matrix *m, number_t *order, number_t *core);
+
+// Maximum cardinality search: order receives the vertices in visit order,
+// each time the unvisited vertex with the most visited neighbors. If m is
+// chordal, the reverse of order is a perfect elimination order. O(n + nnz).
+void matrix_mcs_order(const struct matrix *m, number_t *order);
+
+// Whether the visited-before neighbors of every vertex form a clique, i.e.
+// the reverse of order is a perfect elimination order. For an MCS order this
+// holds iff m is chordal.
+bool matrix_is_reverse_peo(const struct matrix *m, const number_t *order);
+
+enum matrix_order {
+  MATRIX_ORDER_RCM,    // reverse Cuthill-McKee
+  MATRIX_ORDER_DEGREE, // degree, descending
+  MATRIX_ORDER_BFS,    // breadth-first, from the lowest unvisited id
+};
+
+// Computes a vertex order of m into perm (perm[new] = old, n_vertices
+// entries) and returns m renumbered by it. Vertices that are close in the
+// order are then close in memory, which is what the solver's neighbor
+// lookups need.
+struct matrix *matrix_reorder(const struct matrix *m, const enum matrix_order order, number_t *perm);
+
+// Returns m renumbered so that new vertex u is old vertex perm[u].
+struct matrix *matrix_permute(const struct matrix *m, const number_t *perm);
+
+// Maps a coloring of a renumbered matrix back to the original ids:
+// original->colors[perm[u]] = permuted->colors[u].
+void coloring_unpermute(const struct coloring *permuted, const number_t *perm, struct coloring *original);
 
 struct subgraph {
-    bool *vertices;
+    uint64_t *vertices; // vertex set
 };
 
 void matrix_as_dot_subgraph_color(const struct matrix *m, FILE *f, const struct subgraph *subgraphs, const size_t subgraphs_length, const struct coloring *c);
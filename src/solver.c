@@ -2,199 +2,291 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "solver.h"
 
+// === solver_context implementation ===
+
+struct solver_context *solver_context_create(const struct matrix *g) {
+  struct solver_context *ctx = calloc(1, sizeof(struct solver_context));
+  if (ctx == NULL) {
+    return NULL;
+  }
+  ctx->g = g;
+  ctx->degree = malloc(g->n_vertices * sizeof(size_t));
+  ctx->s = malloc(VSET_WORDS(g->n_vertices) * sizeof(uint64_t));
+  ctx->initial_s = malloc(VSET_WORDS(g->n_vertices) * sizeof(uint64_t));
+  ctx->visited = malloc(VSET_WORDS(g->n_vertices) * sizeof(uint64_t));
+  ctx->active = malloc(g->n_vertices * sizeof(number_t));
+  ctx->next = malloc(g->n_vertices * sizeof(number_t));
+  ctx->keep = malloc((g->n_vertices + 1) * sizeof(offset_t));
+  if (ctx->degree == NULL || ctx->s == NULL || ctx->initial_s == NULL || ctx->visited == NULL || ctx->active == NULL || ctx->next == NULL || ctx->keep == NULL) {
+    solver_context_destroy(ctx);
+    return NULL;
+  }
+  size_t max_degree = 0;
+#pragma omp parallel for schedule(static) reduction(max:max_degree)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    size_t degree = g->row_index[i + 1] - g->row_index[i];
+    if (degree > max_degree) {
+      max_degree = degree;
+    }
+  }
+  ctx->max_degree = max_degree;
+  ctx->n_threads = omp_get_max_threads();
+  ctx->forbidden = calloc(ctx->n_threads * (max_degree + 2), sizeof(bool));
+  if (ctx->forbidden == NULL) {
+    solver_context_destroy(ctx);
+    return NULL;
+  }
+  // first touch: each page is written by the thread whose static chunk of
+  // the solver loops will use it
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    ctx->degree[i] = g->row_index[i + 1] - g->row_index[i];
+    ctx->active[i] = 0;
+    ctx->next[i] = 0;
+    ctx->keep[i] = 0;
+  }
+  ctx->keep[g->n_vertices] = 0;
+#pragma omp parallel for schedule(static)
+  for (size_t w = 0; w < VSET_WORDS(g->n_vertices); w++) {
+    ctx->s[w] = 0;
+    ctx->initial_s[w] = 0;
+    ctx->visited[w] = 0;
+  }
+  return ctx;
+}
+
+void solver_context_destroy(struct solver_context *ctx) {
+  if (ctx == NULL) {
+    return;
+  }
+  free(ctx->degree);
+  free(ctx->s);
+  free(ctx->initial_s);
+  free(ctx->visited);
+  free(ctx->active);
+  free(ctx->next);
+  free(ctx->keep);
+  free(ctx->constrained);
+  free(ctx->forbidden);
+  free(ctx);
+}
+
+// Whether v takes precedence over u: by degree (if degree is not NULL), then
+// by the random priority hash64(key + vertex), then by id. This is a strict
+// total order, so of two adjacent vertices exactly one wins.
+static inline bool priority_beats(const size_t *degree, const uint64_t key, const number_t v, const number_t u) {
+  if (degree != NULL && degree[v] != degree[u]) {
+    return degree[v] > degree[u];
+  }
+  const uint64_t v_priority = hash64(key + v);
+  const uint64_t u_priority = hash64(key + u);
+  if (v_priority != u_priority) {
+    return v_priority > u_priority;
+  }
+  return v > u;
+}
+
+// Returns the smallest color (from 1) that no colored neighbor of u has.
+// forbidden is the calling thread's scratch of max_degree + 2 entries, all
+// false, and is left that way. The colors are read atomically since the
+// speculative engine writes them concurrently.
+static color_t smallest_free_color(const struct matrix *g, const struct coloring *c, const number_t u, bool *forbidden) {
+  const size_t degree = g->row_index[u + 1] - g->row_index[u];
+  // with degree neighbors, one of the colors 1..degree+1 is free
+  for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+    color_t color = __atomic_load_n(&c->colors[g->col_index[j]], __ATOMIC_RELAXED);
+    if (color <= degree + 1) {
+      forbidden[color] = true;
+    }
+  }
+  color_t color = 1;
+  while (forbidden[color]) {
+    color++;
+  }
+  // cleared by range rather than by neighbor, as the neighbors' colors may
+  // have changed since
+  memset(forbidden, 0, (degree + 2) * sizeof(bool));
+  return color;
+}
+
 // === luby_maximal_independent_set implementation ===
 // Cite for algorithm implementation: Eric Vigoda, https://faculty.cc.gatech.edu/~vigoda/RandAlgs/MIS.pdf
 
-bool *alloc_make_neighbors(const struct matrix *g, bool *s) {
-  bool *neighbors = calloc(g->n_vertices, sizeof(bool));
-#pragma omp parallel for shared(neighbors, s, g)
-  for (size_t i = 0; i < g->n_vertices; i++) {
-    // _OPENMP: inner loop is serial, but inner loop has maximum of max(degree) iterations,
-    //          which is expected to be small (<10)
-    for (size_t j = g->row_index[i]; j < g->row_index[i + 1]; j++) {
-      assert(j < g->nnz);
-      size_t u = i;
-      size_t v = g->col_index[j];
-      if (v >= g->n_vertices || u >= g->n_vertices) {
-        printf("===u: %lu, v: %lu\n", u, v);
-        printf("===g->col_index[%lu]: %lu\n", j, g->col_index[j]);
-        printf("===g->n_vertices: %lu\n", g->n_vertices);
-        printf("===g->nnz: %lu\n", g->nnz);
-      }
-      assert(u < g->n_vertices);
-      assert(v < g->n_vertices);
-      if (s[u] || s[v]) {
-        neighbors[u] = true;
-        neighbors[v] = true;
-      }
+// Keeps the vertices active[a] with keep[a] != 0, in order, writing them to
+// next (active may be NULL, standing for 0..n_active-1). keep needs
+// n_active + 1 entries and is overwritten. Returns the number kept.
+static size_t compact_active(const number_t *active, offset_t *keep, const size_t n_active, number_t *next) {
+  keep[n_active] = 0;
+  size_t n_next = exclusive_scan(keep, n_active + 1);
+#pragma omp parallel for schedule(static)
+  for (size_t a = 0; a < n_active; a++) {
+    if (keep[a + 1] != keep[a]) {
+      next[keep[a]] = active != NULL ? active[a] : a;
     }
   }
-  return neighbors;
+  return n_next;
 }
 
-size_t luby_maximal_independent_set(const struct matrix *g, struct coloring *c, const number_t color, bool *initial_s) {
+size_t luby_maximal_independent_set(struct solver_context *ctx, struct coloring *c, const color_t color, const uint64_t *initial_s, const uint64_t seed) {
+  const struct matrix *g = ctx->g;
   assert(c->colors_size == g->n_vertices);
-  size_t *degree = calloc(g->n_vertices, sizeof(size_t));
-  matrix_degree(g, degree);
+  const size_t *degree = ctx->degree;
 
-  size_t remove_count = 0;
+  // G' is kept as a worklist of its vertices (active), compacted after every
+  // round so that a round only costs the vertices and edges still in G'.
+  // S is a bitset so neighbors can be tested for membership; it is empty
+  // between calls.
+  uint64_t *s = ctx->s;
+  number_t *active = ctx->active;
+  number_t *next = ctx->next;
+  offset_t *keep = ctx->keep;
 
-  bool *s = calloc(g->n_vertices, sizeof(bool));
   // G' ← G
-  bool *g_prime = calloc(g->n_vertices, sizeof(bool));
-#pragma omp parallel for shared(g_prime) reduction(+:remove_count)
+#pragma omp parallel for schedule(static)
   for (size_t i = 0; i < g->n_vertices; i++) {
-    if ((c->colors[i] != 0 && c->colors[i] != color) || degree[i] <= 0) {
-      g_prime[i] = false;
-      remove_count++;
-    } else {
-      g_prime[i] = true;
-    }
+    keep[i] = !((c->colors[i] != 0 && c->colors[i] != color) || degree[i] <= 0);
   }
+  size_t n_active = compact_active(NULL, keep, g->n_vertices, active);
 
 #ifdef DEBUG
-    printf("remove_count: %lu\n", remove_count);
+    printf("n_active: %lu\n", n_active);
     printf("g->n_vertices: %lu\n", g->n_vertices);
-    size_t g_prime_size = 0;
-    for (size_t i = 0; i < g->n_vertices; i++) {
-      if (g_prime[i]) {
-        g_prime_size++;
-      }
-    }
-    printf("g_prime_size: %lu\n", g_prime_size);
-    printf("g->n_vertices minus remove_count: %lu\n", g->n_vertices - remove_count);
     printf("===\n");
 #endif
 
   size_t colored_count = 0;
+  size_t round = 0;
 #ifdef DEBUG
   size_t iter_count = 0;
 #endif
   // while G' is not the empty graph
-  while (remove_count < g->n_vertices) {
+  while (n_active > 0) {
+    const uint64_t round_key = hash64(hash64(seed) + round++);
+    // S only ever holds vertices of G', so clearing it is part of the
+    // compaction below.
     if (initial_s != NULL) {
-      memcpy(s, initial_s, g->n_vertices * sizeof(bool));
+#pragma omp parallel for schedule(static)
+      for (size_t a = 0; a < n_active; a++) {
+        if (vset_test(initial_s, active[a])) {
+          vset_add_atomic(s, active[a]);
+        }
+      }
       initial_s = NULL;
     } else {
-      memset(s, 0, g->n_vertices * sizeof(bool));
       // Choose a random set of vertices S in G' by selecting each vertex v
       // independently with probability 1/(2d(v)).
-#pragma omp parallel for shared(s)
-      for (size_t i = 0; i < g->n_vertices; i++) {
-        if (g_prime[i]) {
-          assert(degree[i] > 0);
-          if (random() % (2 * degree[i]) == 0) {
-            s[i] = true;
-          }
+#pragma omp parallel for schedule(static)
+      for (size_t a = 0; a < n_active; a++) {
+        number_t i = active[a];
+        assert(degree[i] > 0);
+        if (hash64(round_key + i) % (2 * degree[i]) == 0) {
+          vset_add_atomic(s, i);
         }
       }
     }
 
     // For every edge (u, v) ∈ E(G') if both endpoints are in S then remove
-    // the vertex of lower degree from S (break ties arbitrarily).
-    /*struct luby_step2b_arg arg;*/
-    /*arg.degree = degree;*/
-    /*arg.s = s;*/
-    /*arg.g_prime = g_prime;*/
-    /*matrix_iterate_edges(g, luby_step2b, &arg);*/
-    {
+    // the vertex of lower degree from S, breaking ties by a random priority
+    // and then by id. A vertex stays only if it beats all its neighbors in S,
+    // which is decided from S as sampled (read only, into keep) and then
+    // committed, so the result does not depend on the order of the threads.
+    const uint64_t priority_key = hash64(round_key);
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      number_t u = active[a];
+      keep[a] = 1;
+      if (!vset_test(s, u)) {
+        continue;
+      }
       // _OPENMP: inner loop is serial, but inner loop has maximum of max(degree) iterations,
       //          which is expected to be small (<10)
-#pragma omp parallel for shared(s)
-      for (size_t i = 0; i < g->n_vertices; i++) {
-        for (size_t j = g->row_index[i]; j < g->row_index[i + 1]; j++) {
-          size_t u = i;
-          size_t v = g->col_index[j];
-          // every edge must:
-          // - be in G' (membership represented by g_prime), and
-          // - have both endpoints in S (membership represented by s)
-          if (s[u] && s[v] && g_prime[u] && g_prime[v]) {
-            // remove the vertex of lower degree
-            if (degree[u] < degree[v]) {
-              s[u] = false;
-            } else { // tie breaked arbitrarily
-              s[v] = false;
-            }
-          }
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+        number_t v = g->col_index[j];
+        if (vset_test(s, v) && priority_beats(degree, priority_key, v, u)) {
+          keep[a] = 0;
+          break;
         }
       }
     }
-
-    // add S to our independent set
-    for (size_t i = 0; i < g->n_vertices; i++) {
-      if (s[i]) {
-        c->colors[i] = color;
-        colored_count++;
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      if (!keep[a]) {
+        vset_remove_atomic(s, active[a]);
       }
     }
+
+    // add S to our independent set, and
     // G' = G'\(S ⋃ neighbors of S), i.e., G' is the induced subgraph
     // on V' \ (S ⋃ neighbors of S) where V' is the previous vertex set.
-    bool *is_neighbor = alloc_make_neighbors(g, s);
-    for (size_t i = 0; i < g->n_vertices; i++) {
-      if ((s[i] || is_neighbor[i]) && g_prime[i]) {
-        g_prime[i] = false;
-        remove_count++;
+#pragma omp parallel for schedule(static) reduction(+:colored_count)
+    for (size_t a = 0; a < n_active; a++) {
+      number_t u = active[a];
+      if (vset_test(s, u)) {
+        c->colors[u] = color;
+        colored_count++;
+        keep[a] = 0;
+        continue;
+      }
+      keep[a] = 1;
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+        number_t v = g->col_index[j];
+        if (vset_test(s, v)) {
+          keep[a] = 0;
+          break;
+        }
       }
     }
-    free(is_neighbor);
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      if (vset_test(s, active[a])) {
+        vset_remove_atomic(s, active[a]);
+      }
+    }
+    n_active = compact_active(active, keep, n_active, next);
+    number_t *tmp = active;
+    active = next;
+    next = tmp;
 #ifdef DEBUG
-    printf("remove_count: %lu\n", remove_count);
+    printf("n_active: %lu\n", n_active);
     printf("colored_count: %lu\n", colored_count);
     printf("g->n_vertices: %lu\n", g->n_vertices);
-    size_t g_prime_size = 0;
-    for (size_t i = 0; i < g->n_vertices; i++) {
-      if (g_prime[i]) {
-        g_prime_size++;
-      }
-    }
-    assert(g_prime_size == g->n_vertices - remove_count);
     printf("iter_count: %lu\n", iter_count);
     iter_count++;
 #endif
   }
 
-  free(s);
-  free(g_prime);
-  free(degree);
+  ctx->rounds += round;
   return colored_count;
 }
 
 // === detect_subgraph implementation ===
 
-void array_or(bool *a, bool *b, size_t n) {
-  for (size_t i = 0; i < n; i++) {
-    a[i] = a[i] || b[i];
-  }
-}
-
-void array_remove(bool *a, bool *b, size_t n) {
-  for (size_t i = 0; i < n; i++) {
-    a[i] = a[i] && !b[i];
-  }
-}
-
-size_t traverse(const struct matrix *g, const size_t u, bool *visited) {
+// Marks every vertex reachable from u in visited and returns how many were
+// newly marked. stack needs room for n_vertices entries.
+size_t traverse(const struct matrix *g, const size_t u, uint64_t *visited, number_t *stack) {
   size_t count = 0;
-  size_t *stack = malloc(g->n_vertices * sizeof(size_t));
   size_t stack_size = 0;
   stack[stack_size++] = u;
-  visited[u] = true;
+  vset_add(visited, u);
   count++;
   while (stack_size > 0) {
     size_t v = stack[--stack_size];
     for (size_t j = g->row_index[v]; j < g->row_index[v + 1]; j++) {
-      size_t w = g->col_index[j];
-      if (!visited[w]) {
+      number_t w = g->col_index[j];
+      if (!vset_test(visited, w)) {
         count++;
-        visited[w] = true;
+        vset_add(visited, w);
         stack[stack_size++] = w;
       }
     }
   }
-  free(stack);
   return count;
 }
 
@@ -223,10 +315,12 @@ int qsort_compar2(const void *a, const void *b, void *arg) {
   }
 }
 
-struct subgraph *detect_subgraph(const struct matrix *g, const size_t k, size_t *subgraphs_length) {
+struct subgraph *detect_subgraph(struct solver_context *ctx, const size_t k, size_t *subgraphs_length) {
+  const struct matrix *g = ctx->g;
   assert(k >= 2);
-  size_t *degree = calloc(g->n_vertices, sizeof(size_t));
-  matrix_degree(g, degree);
+  const size_t *degree = ctx->degree;
+  // the traversal stack borrows the Luby worklist, which is free between calls
+  number_t *stack = ctx->active;
   struct subgraph *subgraphs = NULL;
   *subgraphs_length = 0;
 
@@ -244,61 +338,34 @@ struct subgraph *detect_subgraph(const struct matrix *g, const size_t k, size_t
 #endif
 
     // For each neighbor `v` of the vertex, find the total number of vertices traversable from `v` (excluding `u`).
+    // Only the largest two reaches matter, so they are kept as the neighbors are traversed.
     size_t n_neighbors = g->row_index[u + 1] - g->row_index[u];
-    size_t *reachable_via_neighbor = malloc(n_neighbors * sizeof(size_t));
-/*#pragma omp parallel for*/
-    for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
-      size_t v = g->col_index[j];
-      bool *visited = calloc(g->n_vertices, sizeof(bool));
-      visited[u] = true;
-      reachable_via_neighbor[j - g->row_index[u]] = traverse(g, v, visited);
+    size_t largest_reach = 0, largest_reach_index = 0, second_largest_reach = 0, second_largest_reach_index = 0;
+    for (size_t j = 0; j < n_neighbors; j++) {
+      number_t v = g->col_index[g->row_index[u] + j];
+      uint64_t *visited = ctx->visited;
+      memset(visited, 0, VSET_WORDS(g->n_vertices) * sizeof(uint64_t));
+      vset_add(visited, u);
+      size_t reachable_via_neighbor = traverse(g, v, visited, stack);
 #ifdef DEBUG
-      printf("  neighbor %lu: reached %lu vertices\n", v, reachable_via_neighbor[j - g->row_index[u]]);
+      printf("  neighbor %" PRInumber ": reached %lu vertices\n", v, reachable_via_neighbor);
 #endif
-      free(visited);
+      if (j == 0) {
+        largest_reach = reachable_via_neighbor;
+      } else if (j == 1 ? reachable_via_neighbor >= largest_reach : reachable_via_neighbor > largest_reach) {
+        second_largest_reach = largest_reach;
+        second_largest_reach_index = largest_reach_index;
+        largest_reach = reachable_via_neighbor;
+        largest_reach_index = j;
+      } else if (j == 1 || reachable_via_neighbor > second_largest_reach) {
+        second_largest_reach = reachable_via_neighbor;
+        second_largest_reach_index = j;
+      }
     }
 
     // Select a subset of vertices that together have less than half the number of vertices in the graph.
-    size_t effective_reach, effective_reach_index;
-    if (n_neighbors == 1) {
-      effective_reach = reachable_via_neighbor[0];
-      effective_reach_index = 0;
-    } else {
-      for (size_t i = 0; i < n_neighbors; i++) {
-#ifdef DEBUG
-        printf("  reachable_via_neighbor[%lu]: %lu\n", i, reachable_via_neighbor[i]);
-#endif
-      }
-      size_t largest_reach, largest_reach_index, second_largest_reach, second_largest_reach_index;
-      if (reachable_via_neighbor[0] > reachable_via_neighbor[1]) {
-        largest_reach = reachable_via_neighbor[0];
-        largest_reach_index = 0;
-        second_largest_reach = reachable_via_neighbor[1];
-        second_largest_reach_index = 1;
-      } else {
-        largest_reach = reachable_via_neighbor[1];
-        largest_reach_index = 1;
-        second_largest_reach = reachable_via_neighbor[0];
-        second_largest_reach_index = 0;
-      }
-#ifdef DEBUG
-      printf("  n_neighbors: %lu\n", n_neighbors);
-#endif
-      for (size_t j = 2; j < n_neighbors; j++) {
-        if (reachable_via_neighbor[j] > largest_reach) {
-          second_largest_reach = largest_reach;
-          second_largest_reach_index = largest_reach_index;
-          largest_reach = reachable_via_neighbor[j];
-          largest_reach_index = j;
-        } else if (reachable_via_neighbor[j] > second_largest_reach) {
-          second_largest_reach = reachable_via_neighbor[j];
-          second_largest_reach_index = j;
-        }
-      }
-      effective_reach = second_largest_reach;
-      effective_reach_index = second_largest_reach_index;
-    }
-    free(reachable_via_neighbor);
+    size_t effective_reach = n_neighbors == 1 ? largest_reach : second_largest_reach;
+    size_t effective_reach_index = n_neighbors == 1 ? largest_reach_index : second_largest_reach_index;
 
 #ifdef DEBUG
     printf("  effective_reach: %lu\n", effective_reach);
@@ -328,50 +395,49 @@ struct subgraph *detect_subgraph(const struct matrix *g, const size_t k, size_t
   printf("\n");
 #endif
 
-  bool *used_in_subgraph = calloc(g->n_vertices, sizeof(bool));
+  uint64_t *used_in_subgraph = vset_create(g->n_vertices);
   // For every vertex `u` that has a degree less than `k`:
   for (size_t k = 0; k < g->n_vertices; k++) {
     size_t u = sorted_indices[k];
-    if (degree[u] >= k || used_in_subgraph[u] || degree[u] == 0) {
+    if (degree[u] >= k || vset_test(used_in_subgraph, u) || degree[u] == 0) {
       continue;
     }
 #ifdef DEBUG
     printf("starting from sorted_indices[%lu]: vertex %lu with expected size %lu\n", k, u, effective_reaches[u]);
 #endif
     // create subgraph struct
-    struct subgraph new_subgraph = { .vertices = calloc(g->n_vertices, sizeof(bool)) };
+    struct subgraph new_subgraph = { .vertices = vset_create(g->n_vertices) };
     assert(new_subgraph.vertices != NULL);
-    memcpy(new_subgraph.vertices, used_in_subgraph, g->n_vertices * sizeof(bool));
+    memcpy(new_subgraph.vertices, used_in_subgraph, VSET_WORDS(g->n_vertices) * sizeof(uint64_t));
 #ifdef DEBUG
     printf("  effective_reach_index: %lu\n", effective_reach_indices[u]);
-    printf("  g->row_index[u]: %lu\n", g->row_index[u]);
-    printf("  g->row_index[u+1]: %lu\n", g->row_index[u + 1]);
+    printf("  g->row_index[u]: %" PRIoffset "\n", g->row_index[u]);
+    printf("  g->row_index[u+1]: %" PRIoffset "\n", g->row_index[u + 1]);
 #endif
-    size_t neighbor = g->col_index[effective_reach_indices[u] + g->row_index[u]];
+    size_t neighbor = g->col_index[g->row_index[u] + effective_reach_indices[u]];
 #ifdef DEBUG
     printf("  neighbor: %lu\n", neighbor);
 #endif
     assert(neighbor < g->n_vertices);
-    new_subgraph.vertices[u] = true;
+    vset_add(new_subgraph.vertices, u);
 #ifdef DEBUG
-    size_t traversed = traverse(g, u, new_subgraph.vertices);
+    size_t traversed = traverse(g, u, new_subgraph.vertices, stack);
     printf("  traversed: %lu\n", traversed);
 #else
-    traverse(g, u, new_subgraph.vertices);
+    traverse(g, u, new_subgraph.vertices, stack);
 #endif
     // undo the memcpy above
-    array_remove(new_subgraph.vertices, used_in_subgraph, g->n_vertices);
-    new_subgraph.vertices[u] = true;
+    vset_difference(new_subgraph.vertices, used_in_subgraph, g->n_vertices);
+    vset_add(new_subgraph.vertices, u);
 
     // make sure the subgraphs form a partition of the entire graph
-    array_or(used_in_subgraph, new_subgraph.vertices, g->n_vertices);
+    vset_union(used_in_subgraph, new_subgraph.vertices, g->n_vertices);
 
     // add to subgraphs list
     subgraphs = realloc(subgraphs, (*subgraphs_length + 1) * sizeof(struct subgraph));
     subgraphs[*subgraphs_length] = new_subgraph;
     *subgraphs_length = *subgraphs_length + 1;
   }
-  free(degree);
   free(used_in_subgraph);
   return subgraphs;
 }
@@ -382,14 +448,14 @@ struct find_initial_constraints_arg {
   size_t *constrained_vertices;
   size_t k;
   size_t filled;
-  bool *selection;
+  const uint64_t *selection;
 };
 
 void find_initial_constraints(number_t u, number_t v, void *data) {
   struct find_initial_constraints_arg *arg = (struct find_initial_constraints_arg *) data;
   size_t *constrained_vertices = arg->constrained_vertices;
-  bool *selection = arg->selection;
-  if (selection != NULL && !(selection[u] && selection[v])) {
+  const uint64_t *selection = arg->selection;
+  if (selection != NULL && !(vset_test(selection, u) && vset_test(selection, v))) {
     return;
   }
 #define k arg->k
@@ -436,15 +502,25 @@ void find_initial_constraints(number_t u, number_t v, void *data) {
 #undef filled
 }
 
-void color_cliquelike(const struct matrix *g, struct coloring *c, const size_t k, bool *selection) {
+void color_cliquelike(struct solver_context *ctx, struct coloring *c, const size_t k, const uint64_t *selection, const uint64_t seed) {
+  const struct matrix *g = ctx->g;
   assert(c->colors_size == g->n_vertices);
+  // colors run from 1 to k; build with a wider COLOR_BITS if this fails
+  assert(k <= COLOR_MAX);
+  ctx->rounds = 0;
   for (size_t i = 0; i < c->colors_size; i++) {
     c->colors[i] = 0;
   }
   // find initial constraints where results are known to have different colors
   // these constraints will be used to run Luby's in parallel later
+  if (ctx->constrained_size < k) {
+    free(ctx->constrained);
+    ctx->constrained = malloc(k * sizeof(size_t));
+    assert(ctx->constrained != NULL);
+    ctx->constrained_size = k;
+  }
   struct find_initial_constraints_arg arg;
-  arg.constrained_vertices = malloc(k * sizeof(size_t));
+  arg.constrained_vertices = ctx->constrained;
   arg.k = k;
   arg.filled = 0;
   arg.selection = selection;
@@ -453,29 +529,1426 @@ void color_cliquelike(const struct matrix *g, struct coloring *c, const size_t k
   size_t colored_count = 0;
 
   // color all isolated vertices
-  size_t *degree = calloc(g->n_vertices, sizeof(size_t));
-  matrix_degree(g, degree);
   for (size_t i = 0; i < g->n_vertices; i++) {
-    if (degree[i] == 0) {
+    if (ctx->degree[i] == 0) {
       c->colors[i] = 1;
       colored_count++;
     }
   }
-  free(degree);
 
   for (size_t i = 0; i < arg.filled; i ++) {
     printf("  coloring vertex from vertex %lu with color %lu\n", arg.constrained_vertices[i], i+1);
-    bool *initial_s = calloc(g->n_vertices, sizeof(bool));
-    initial_s[arg.constrained_vertices[i]] = true;
+    uint64_t *initial_s = ctx->initial_s;
+    vset_add(initial_s, arg.constrained_vertices[i]);
     /*for (size_t i = 0; i < g->n_vertices; i++) {*/
     /*  if (selection != NULL && !selection[i]) {*/
     /*    c->colors[i] = 99;*/
     /*  }*/
     /*}*/
-    colored_count += luby_maximal_independent_set(g, c, i+1, initial_s);
-    free(initial_s);
+    colored_count += luby_maximal_independent_set(ctx, c, i+1, initial_s, seed + i+1);
+    vset_remove(initial_s, arg.constrained_vertices[i]);
+  }
+  // the constraint scan depends on vertex order and may stop short of k, so
+  // keep taking independent sets until every vertex is colored
+  for (size_t color = arg.filled + 1; colored_count < g->n_vertices && color <= k; color++) {
+    colored_count += luby_maximal_independent_set(ctx, c, color, NULL, seed + color);
+  }
+  // A vertex left out of a maximal independent set has a neighbor in it, so
+  // with k >= max_degree + 1 this never happens. A smaller k (as test_solver
+  // uses) gets the rest colored greedily, which can go past k: callers that
+  // rely on colors 1..k must pass max_degree + 1.
+  if (colored_count < g->n_vertices) {
+    printf("  %zu vertices left after %zu colors, coloring them greedily\n", g->n_vertices - colored_count, k);
+    for (size_t i = 0; i < g->n_vertices; i++) {
+      if (c->colors[i] == 0) {
+        c->colors[i] = smallest_free_color(g, c, i, ctx->forbidden);
+      }
+    }
   }
 
-  free(arg.constrained_vertices);
   return;
 }
+
+// === color_jones_plassmann implementation ===
+// Cite: Jones and Plassmann, "A Parallel Graph Coloring Heuristic", SIAM J. Sci. Comput. 14(3), 1993
+
+void color_jones_plassmann(struct solver_context *ctx, struct coloring *c, const bool largest_degree_first, const uint64_t seed) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  // colors run up to max_degree + 1
+  assert(ctx->max_degree < COLOR_MAX);
+  assert(omp_get_max_threads() <= ctx->n_threads);
+  const size_t *degree = largest_degree_first ? ctx->degree : NULL;
+  const uint64_t priority_key = hash64(seed);
+  number_t *active = ctx->active;
+  number_t *next = ctx->next;
+  offset_t *keep = ctx->keep;
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[i] = 0;
+    keep[i] = 1;
+  }
+  size_t n_active = compact_active(NULL, keep, g->n_vertices, active);
+
+  size_t rounds = 0;
+  while (n_active > 0) {
+    // A vertex is colored once every neighbor that beats it is colored. Of
+    // two adjacent uncolored vertices one beats the other, so the vertices
+    // colored in a round are independent and only read settled colors.
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      number_t u = active[a];
+      keep[a] = 0;
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+        number_t v = g->col_index[j];
+        if (c->colors[v] == 0 && priority_beats(degree, priority_key, v, u)) {
+          keep[a] = 1;
+          break;
+        }
+      }
+    }
+#pragma omp parallel
+    {
+    bool *forbidden = ctx->forbidden + omp_get_thread_num() * (ctx->max_degree + 2);
+#pragma omp for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      if (!keep[a]) {
+        c->colors[active[a]] = smallest_free_color(g, c, active[a], forbidden);
+      }
+    }
+    }
+    n_active = compact_active(active, keep, n_active, next);
+    number_t *tmp = active;
+    active = next;
+    next = tmp;
+    rounds++;
+  }
+  ctx->rounds = rounds;
+}
+
+// === color_smallest_last implementation ===
+// Cite: Matula and Beck, "Smallest-last ordering and clustering and graph
+// coloring algorithms", J. ACM 30(3), 1983
+
+size_t color_smallest_last(struct solver_context *ctx, struct coloring *c) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  assert(ctx->max_degree < COLOR_MAX);
+  // the removal order borrows the worklist buffer
+  number_t *order = ctx->next;
+  size_t degeneracy = matrix_degeneracy_order(g, order, NULL);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[i] = 0;
+  }
+  // The greedy pass is serial: in smallest-last order each vertex has at
+  // most degeneracy neighbors colored before it, but those form chains as
+  // long as the graph, so Jones-Plassmann on these ranks could take O(n)
+  // rounds. The pass is O(n + nnz) regardless.
+  for (size_t i = g->n_vertices; i-- > 0;) {
+    c->colors[order[i]] = smallest_free_color(g, c, order[i], ctx->forbidden);
+  }
+  ctx->rounds = 1;
+  return degeneracy;
+}
+
+// === color_chordal implementation ===
+
+bool color_chordal(struct solver_context *ctx, struct coloring *c, const uint64_t seed) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  assert(ctx->max_degree < COLOR_MAX);
+  // the visit order borrows the worklist buffer
+  number_t *order = ctx->next;
+  matrix_mcs_order(g, order);
+  if (!matrix_is_reverse_peo(g, order)) {
+    printf("  not chordal, falling back to Jones-Plassmann (LDF)\n");
+    color_jones_plassmann(ctx, c, true, seed);
+    return false;
+  }
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[i] = 0;
+  }
+  // the colored neighbors of each vertex form a clique, so the smallest free
+  // color never exceeds the largest clique: the coloring is optimal
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[order[i]] = smallest_free_color(g, c, order[i], ctx->forbidden);
+  }
+  ctx->rounds = 1;
+  return true;
+}
+
+// === color_speculative_greedy implementation ===
+// Cite: Gebremedhin and Manne, "Scalable parallel graph coloring algorithms",
+// Concurrency: Pract. Exper. 12(12), 2000; and Catalyurek et al., "Graph
+// coloring algorithms for multi-core and massively multithreaded
+// architectures", Parallel Computing 38(10-11), 2012
+
+void color_speculative_greedy(struct solver_context *ctx, struct coloring *c) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  assert(ctx->max_degree < COLOR_MAX);
+  assert(omp_get_max_threads() <= ctx->n_threads);
+  number_t *active = ctx->active;
+  number_t *next = ctx->next;
+  offset_t *keep = ctx->keep;
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[i] = 0;
+    keep[i] = 1;
+  }
+  size_t n_active = compact_active(NULL, keep, g->n_vertices, active);
+
+  size_t rounds = 0;
+  while (n_active > 0) {
+    // speculate: color greedily against whatever the neighbors have now,
+    // including neighbors other threads are coloring at the same time
+#pragma omp parallel
+    {
+    bool *forbidden = ctx->forbidden + omp_get_thread_num() * (ctx->max_degree + 2);
+#pragma omp for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      __atomic_store_n(&c->colors[active[a]], smallest_free_color(g, c, active[a], forbidden), __ATOMIC_RELAXED);
+    }
+    }
+    // detect: of two adjacent vertices with the same color, the higher id is
+    // recolored in the next round
+    size_t conflicts = 0;
+#pragma omp parallel for schedule(static) reduction(+:conflicts)
+    for (size_t a = 0; a < n_active; a++) {
+      number_t u = active[a];
+      keep[a] = 0;
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+        number_t v = g->col_index[j];
+        if (v < u && c->colors[v] == c->colors[u]) {
+          keep[a] = 1;
+          conflicts++;
+          break;
+        }
+      }
+    }
+    rounds++;
+    printf("  speculative round %zu: %zu vertices, %zu conflicts\n", rounds, n_active, conflicts);
+    n_active = compact_active(active, keep, n_active, next);
+    number_t *tmp = active;
+    active = next;
+    next = tmp;
+  }
+  ctx->rounds = rounds;
+}
+
+// === color_distance2 implementation ===
+// Cite: Bozdag et al., "Distributed-memory parallel algorithms for distance-2
+// coloring and related problems in derivative computation", SIAM J. Sci.
+// Comput. 32(4), 2010
+
+// Returns the smallest color (from 1) that no colored vertex within distance
+// 2 of u has. forbidden is the calling thread's scratch of n_colors entries,
+// where a color is taken when its entry is epoch; every call passes a fresh
+// epoch, so nothing needs clearing.
+static color_t smallest_free_color_distance2(const struct matrix *g, const struct coloring *c, const number_t u, size_t *forbidden, const size_t n_colors, const size_t epoch) {
+  for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+    number_t v = g->col_index[j];
+    color_t color = __atomic_load_n(&c->colors[v], __ATOMIC_RELAXED);
+    if (color < n_colors) {
+      forbidden[color] = epoch;
+    }
+    for (size_t k = g->row_index[v]; k < g->row_index[v + 1]; k++) {
+      number_t w = g->col_index[k];
+      color = __atomic_load_n(&c->colors[w], __ATOMIC_RELAXED);
+      if (w != u && color < n_colors) {
+        forbidden[color] = epoch;
+      }
+    }
+  }
+  size_t color = 1;
+  while (forbidden[color] == epoch) {
+    color++;
+  }
+  assert(color < n_colors && color <= COLOR_MAX);
+  return color;
+}
+
+void color_distance2(struct solver_context *ctx, struct coloring *c) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  assert(omp_get_max_threads() <= ctx->n_threads);
+  // u reaches at most degree(u) + sum of (degree(v) - 1) over its neighbors v
+  // within distance 2, and at most n_vertices - 1, so at most that many
+  // colors are taken around it and its color stays below n_colors
+  size_t max_reach = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(max:max_reach)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    size_t reach = ctx->degree[i];
+    for (size_t j = g->row_index[i]; j < g->row_index[i + 1]; j++) {
+      number_t v = g->col_index[j];
+      reach += ctx->degree[v] - 1;
+    }
+    max_reach = reach > max_reach ? reach : max_reach;
+  }
+  size_t n_colors = (max_reach < g->n_vertices ? max_reach : g->n_vertices) + 2;
+  size_t *forbidden = calloc(ctx->n_threads * n_colors, sizeof(size_t));
+  size_t *epoch = calloc(ctx->n_threads, sizeof(size_t));
+  assert(forbidden != NULL && epoch != NULL);
+  number_t *active = ctx->active;
+  number_t *next = ctx->next;
+  offset_t *keep = ctx->keep;
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[i] = 0;
+    keep[i] = 1;
+  }
+  size_t n_active = compact_active(NULL, keep, g->n_vertices, active);
+
+  size_t rounds = 0;
+  while (n_active > 0) {
+    // speculate, as in color_speculative_greedy, but against both rings
+#pragma omp parallel
+    {
+    size_t *thread_forbidden = forbidden + omp_get_thread_num() * n_colors;
+    size_t *thread_epoch = &epoch[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 64)
+    for (size_t a = 0; a < n_active; a++) {
+      __atomic_store_n(&c->colors[active[a]], smallest_free_color_distance2(g, c, active[a], thread_forbidden, n_colors, ++*thread_epoch), __ATOMIC_RELAXED);
+    }
+    }
+    // detect: of two vertices within distance 2 with the same color, the
+    // higher id is recolored in the next round
+    size_t conflicts = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:conflicts)
+    for (size_t a = 0; a < n_active; a++) {
+      number_t u = active[a];
+      keep[a] = 0;
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1] && !keep[a]; j++) {
+        number_t v = g->col_index[j];
+        if (v < u && c->colors[v] == c->colors[u]) {
+          keep[a] = 1;
+        }
+        for (size_t k = g->row_index[v]; k < g->row_index[v + 1] && !keep[a]; k++) {
+          number_t w = g->col_index[k];
+          if (w < u && c->colors[w] == c->colors[u]) {
+            keep[a] = 1;
+          }
+        }
+      }
+      conflicts += keep[a];
+    }
+    rounds++;
+    printf("  distance-2 round %zu: %zu vertices, %zu conflicts\n", rounds, n_active, conflicts);
+    n_active = compact_active(active, keep, n_active, next);
+    number_t *tmp = active;
+    active = next;
+    next = tmp;
+  }
+  ctx->rounds = rounds;
+  free(forbidden);
+  free(epoch);
+}
+
+// === color_iterated_greedy implementation ===
+// Cite: Culberson and Luo, "Exploring the k-colorable Landscape with Iterated Greedy", DIMACS Series 26, 1996
+
+color_t color_iterated_greedy(struct solver_context *ctx, struct coloring *c, const size_t max_iterations, const double time_budget, const uint64_t seed) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  const double start = omp_get_wtime();
+  // every vertex must be in a class: a color 0 would have no class to go in
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    assert(c->colors[i] != 0);
+  }
+  const color_t before = coloring_max_color(c);
+  color_t k = before;
+  size_t *classes = malloc((k + 1) * sizeof(size_t));
+  size_t *class_size = malloc((k + 1) * sizeof(size_t));
+  offset_t *class_start = malloc((k + 2) * sizeof(offset_t));
+  struct coloring w = {
+    .colors = malloc(g->n_vertices * sizeof(color_t)),
+    .colors_size = g->n_vertices,
+  };
+  assert(classes != NULL && class_size != NULL && class_start != NULL && w.colors != NULL);
+  // the vertices laid out class by class borrow the worklist buffer
+  number_t *by_class = ctx->next;
+  size_t iteration = 0;
+  for (; iteration < max_iterations && (time_budget <= 0 || omp_get_wtime() - start < time_budget); iteration++) {
+    memset(class_size, 0, (k + 1) * sizeof(size_t));
+    for (size_t i = 0; i < g->n_vertices; i++) {
+      class_size[c->colors[i]]++;
+    }
+    // alternate the class orders Culberson recommends: reverse, largest
+    // first and random
+    for (size_t i = 0; i < k; i++) {
+      classes[i] = i + 1;
+    }
+    switch (iteration % 3) {
+    case 0:
+      for (size_t i = 0; i < k; i++) {
+        classes[i] = k - i;
+      }
+      break;
+    case 1:
+      qsort_r(classes, k, sizeof(size_t), qsort_compar2, class_size);
+      for (size_t i = 0; i < k / 2; i++) {
+        size_t t = classes[i];
+        classes[i] = classes[k - 1 - i];
+        classes[k - 1 - i] = t;
+      }
+      break;
+    default: {
+      const uint64_t key = hash64(hash64(seed) + iteration);
+      for (size_t i = k; i > 1; i--) {
+        size_t j = hash64(key + i) % i;
+        size_t t = classes[i - 1];
+        classes[i - 1] = classes[j];
+        classes[j] = t;
+      }
+      break;
+    }
+    }
+    class_start[0] = 0;
+    for (size_t i = 0; i < k; i++) {
+      class_start[i + 1] = class_start[i] + class_size[classes[i]];
+    }
+    // class_size becomes each class's insertion cursor
+    for (size_t i = 0; i < k; i++) {
+      class_size[classes[i]] = class_start[i];
+    }
+    for (size_t i = 0; i < g->n_vertices; i++) {
+      by_class[class_size[c->colors[i]]++] = i;
+    }
+    // a class is independent, so its vertices are recolored in parallel
+    // against the classes before it, and the result does not depend on the
+    // number of threads
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < g->n_vertices; i++) {
+      w.colors[i] = 0;
+    }
+    for (size_t i = 0; i < k; i++) {
+#pragma omp parallel
+      {
+        bool *forbidden = ctx->forbidden + omp_get_thread_num() * (ctx->max_degree + 2);
+#pragma omp for schedule(static)
+        for (offset_t a = class_start[i]; a < class_start[i + 1]; a++) {
+          w.colors[by_class[a]] = smallest_free_color(g, &w, by_class[a], forbidden);
+        }
+      }
+    }
+    // each vertex gets at most the position of its old class, so the count
+    // never grows and the latest coloring is the best one
+    color_t recolored = coloring_max_color(&w);
+    assert(recolored <= k);
+    memcpy(c->colors, w.colors, g->n_vertices * sizeof(color_t));
+    k = recolored;
+  }
+  printf("  iterated greedy: %" PRIcolor " -> %" PRIcolor " colors in %zu iterations\n", before, k, iteration);
+  free(classes);
+  free(class_size);
+  free(class_start);
+  free(w.colors);
+  return k;
+}
+
+// === color_balance implementation ===
+// Cite: Lu et al., "Balanced coloring for parallel computing applications",
+// IPDPS 2015 (vertex-centric shuffling)
+
+// Counts the vertices of each color 1..k into size; color 0 is not counted.
+static void class_sizes(const struct coloring *c, const color_t k, size_t *size) {
+  memset(size, 0, ((size_t) k + 1) * sizeof(size_t));
+#pragma omp parallel for schedule(static) reduction(+:size[:k + 1])
+  for (size_t i = 0; i < c->colors_size; i++) {
+    size[c->colors[i]]++;
+  }
+}
+
+// Prints the smallest and largest of the classes 1..k and returns their
+// difference.
+static size_t class_spread(const size_t *size, const color_t k, const char *when) {
+  size_t smallest = SIZE_MAX;
+  size_t largest = 0;
+  for (size_t color = 1; color <= k; color++) {
+    smallest = size[color] < smallest ? size[color] : smallest;
+    largest = size[color] > largest ? size[color] : largest;
+  }
+  if (k == 0) {
+    smallest = 0;
+  }
+  printf("  class sizes %s: %zu to %zu (spread %zu)\n", when, smallest, largest, largest - smallest);
+  return largest - smallest;
+}
+
+size_t color_balance(struct solver_context *ctx, struct coloring *c, const size_t max_rounds, const uint64_t seed) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  assert(omp_get_max_threads() <= ctx->n_threads);
+  const color_t k = coloring_max_color(c);
+  size_t *size = malloc(((size_t) k + 1) * sizeof(size_t));
+  size_t *received = malloc(((size_t) k + 1) * sizeof(size_t));
+  color_t *under = malloc(((size_t) k + 1) * sizeof(color_t));
+  // a color is taken around u when its entry is the thread's current epoch,
+  // as in color_distance2
+  size_t *taken = calloc(ctx->n_threads * ((size_t) k + 1), sizeof(size_t));
+  size_t *epoch = calloc(ctx->n_threads, sizeof(size_t));
+  color_t *dest = malloc(g->n_vertices * sizeof(color_t));
+  offset_t *keep = ctx->keep;
+  assert(size != NULL && received != NULL && under != NULL && taken != NULL && epoch != NULL && dest != NULL);
+  class_sizes(c, k, size);
+  class_spread(size, k, "before");
+  size_t colored = g->n_vertices - size[0];
+  const size_t target = k > 0 ? (colored + k - 1) / k : 0;
+
+  size_t round = 0;
+  size_t moved = 1;
+  for (; round < max_rounds && moved > 0; round++) {
+    size_t n_under = 0;
+    for (color_t color = 1; color <= k; color++) {
+      if (size[color] < target) {
+        under[n_under++] = color;
+      }
+      received[color] = 0;
+    }
+    if (n_under == 0) {
+      break;
+    }
+    const uint64_t key = hash64(hash64(seed) + round);
+    // propose: about the excess of each oversized class, picked by hash,
+    // heads for an undersized color that none of its neighbors has
+#pragma omp parallel
+    {
+    size_t *thread_taken = taken + omp_get_thread_num() * ((size_t) k + 1);
+    size_t *thread_epoch = &epoch[omp_get_thread_num()];
+#pragma omp for schedule(static)
+    for (size_t u = 0; u < g->n_vertices; u++) {
+      color_t color = c->colors[u];
+      dest[u] = 0;
+      if (color == 0 || size[color] <= target || hash64(key + u) % size[color] >= size[color] - target) {
+        continue;
+      }
+      ++*thread_epoch;
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+        number_t v = g->col_index[j];
+        thread_taken[c->colors[v]] = *thread_epoch;
+      }
+      size_t offset = hash64(key ^ u) % n_under;
+      for (size_t j = 0; j < n_under; j++) {
+        color_t candidate = under[(offset + j) % n_under];
+        if (thread_taken[candidate] != *thread_epoch) {
+          dest[u] = candidate;
+          break;
+        }
+      }
+    }
+    }
+    // resolve: of two adjacent vertices heading for the same color the lower
+    // id goes; dest is only read here, so every thread sees the proposals
+#pragma omp parallel for schedule(static)
+    for (size_t u = 0; u < g->n_vertices; u++) {
+      keep[u] = dest[u] != 0;
+      if (!keep[u]) {
+        continue;
+      }
+      for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+        number_t v = g->col_index[j];
+        if (v < u && dest[v] == dest[u]) {
+          keep[u] = 0;
+          break;
+        }
+      }
+    }
+    // move: each color takes the winners only up to its deficit
+    moved = 0;
+#pragma omp parallel for schedule(static) reduction(+:moved)
+    for (size_t u = 0; u < g->n_vertices; u++) {
+      if (keep[u] && __atomic_fetch_add(&received[dest[u]], 1, __ATOMIC_RELAXED) < target - size[dest[u]]) {
+        c->colors[u] = dest[u];
+        moved++;
+      }
+    }
+    class_sizes(c, k, size);
+  }
+  size_t spread = class_spread(size, k, "after");
+  printf("  balanced in %zu rounds\n", round);
+  free(size);
+  free(received);
+  free(under);
+  free(taken);
+  free(epoch);
+  free(dest);
+  return spread;
+}
+
+// === color_register_allocation implementation ===
+// Cite: Chaitin, "Register allocation & spilling via graph coloring", SIGPLAN
+// Notices 17(6), 1982; and Briggs, Cooper and Torczon, "Improvements to graph
+// coloring register allocation", TOPLAS 16(3), 1994
+
+// batches smaller than this are colored by one thread
+#define REGISTER_ALLOCATION_PARALLEL_BATCH 1024
+
+// Chaitin's spill metric: cost per remaining interference
+static inline bool spill_beats(const double *spill_cost, const size_t *degree_left, const number_t v, const number_t u) {
+  double metric_v = spill_cost[v] / degree_left[v];
+  double metric_u = spill_cost[u] / degree_left[u];
+  if (metric_v != metric_u) {
+    return metric_v < metric_u;
+  }
+  return v < u;
+}
+
+size_t color_register_allocation(struct solver_context *ctx, struct coloring *c, const size_t k, const double *spill_cost, number_t *spilled) {
+  const struct matrix *g = ctx->g;
+  assert(c->colors_size == g->n_vertices);
+  assert(k >= 1 && k <= COLOR_MAX);
+  assert(omp_get_max_threads() <= ctx->n_threads);
+  number_t *active = ctx->active;
+  number_t *next = ctx->next;
+  offset_t *keep = ctx->keep;
+  uint64_t *removed = ctx->s;
+  size_t *degree_left = malloc(g->n_vertices * sizeof(size_t));
+  // the simplify stack, as batches: batch b is stack[batch_start[b]..batch_start[b + 1])
+  number_t *stack = malloc(g->n_vertices * sizeof(number_t));
+  offset_t *batch_start = malloc((g->n_vertices + 1) * sizeof(offset_t));
+  assert(degree_left != NULL && stack != NULL && batch_start != NULL);
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    c->colors[i] = 0;
+    degree_left[i] = ctx->degree[i];
+    keep[i] = 1;
+  }
+  size_t n_active = compact_active(NULL, keep, g->n_vertices, active);
+
+  // simplify: each round removes every vertex with fewer than k remaining
+  // neighbors at once, since removing some never makes the others harder to
+  // color. If there is none, the remaining vertices that beat all their
+  // remaining neighbors on the spill metric are removed instead as spill
+  // candidates; they are independent, and colored optimistically in select.
+  size_t n_stack = 0;
+  size_t n_batches = 0;
+  size_t n_candidates = 0;
+  while (n_active > 0) {
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      keep[a] = degree_left[active[a]] < k;
+    }
+    size_t n_batch = compact_active(active, keep, n_active, stack + n_stack);
+    if (n_batch == 0) {
+#pragma omp parallel for schedule(static)
+      for (size_t a = 0; a < n_active; a++) {
+        number_t u = active[a];
+        keep[a] = 1;
+        for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+          number_t v = g->col_index[j];
+          if (!vset_test(removed, v) && spill_beats(spill_cost, degree_left, v, u)) {
+            keep[a] = 0;
+            break;
+          }
+        }
+      }
+      n_batch = compact_active(active, keep, n_active, stack + n_stack);
+      n_candidates += n_batch;
+    }
+    const number_t *batch = stack + n_stack;
+#pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < n_batch; b++) {
+      vset_add_atomic(removed, batch[b]);
+    }
+#pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < n_batch; b++) {
+      for (size_t j = g->row_index[batch[b]]; j < g->row_index[batch[b] + 1]; j++) {
+        number_t v = g->col_index[j];
+        if (!vset_test(removed, v)) {
+          __atomic_fetch_sub(&degree_left[v], 1, __ATOMIC_RELAXED);
+        }
+      }
+    }
+    batch_start[n_batches++] = n_stack;
+    n_stack += n_batch;
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      keep[a] = !vset_test(removed, active[a]);
+    }
+    n_active = compact_active(active, keep, n_active, next);
+    number_t *tmp = active;
+    active = next;
+    next = tmp;
+  }
+  batch_start[n_batches] = n_stack;
+
+  // select: pop the batches in reverse. A simplified vertex has fewer than k
+  // neighbors in its own and later batches, which are the only ones colored
+  // so far, so it always gets a color up to k; the batch is colored
+  // speculatively, as in color_speculative_greedy. A spill candidate that
+  // finds no free color up to k is spilled.
+  for (size_t b = n_batches; b-- > 0;) {
+    const number_t *batch = stack + batch_start[b];
+    size_t n_active = batch_start[b + 1] - batch_start[b];
+    memcpy(active, batch, n_active * sizeof(number_t));
+    const bool parallel = n_active >= REGISTER_ALLOCATION_PARALLEL_BATCH;
+    while (n_active > 0) {
+#pragma omp parallel if (parallel)
+      {
+      bool *forbidden = ctx->forbidden + omp_get_thread_num() * (ctx->max_degree + 2);
+#pragma omp for schedule(static)
+      for (size_t a = 0; a < n_active; a++) {
+        __atomic_store_n(&c->colors[active[a]], smallest_free_color(g, c, active[a], forbidden), __ATOMIC_RELAXED);
+      }
+      }
+#pragma omp parallel for schedule(static) if (parallel)
+      for (size_t a = 0; a < n_active; a++) {
+        number_t u = active[a];
+        keep[a] = 0;
+        for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+          number_t v = g->col_index[j];
+          if (v < u && c->colors[v] == c->colors[u]) {
+            keep[a] = 1;
+            break;
+          }
+        }
+      }
+      n_active = compact_active(active, keep, n_active, next);
+      number_t *tmp = active;
+      active = next;
+      next = tmp;
+    }
+#pragma omp parallel for schedule(static) if (parallel)
+    for (offset_t a = batch_start[b]; a < batch_start[b + 1]; a++) {
+      if (c->colors[stack[a]] > k) {
+        c->colors[stack[a]] = 0;
+      }
+    }
+  }
+
+  memset(removed, 0, VSET_WORDS(g->n_vertices) * sizeof(uint64_t));
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    keep[i] = c->colors[i] == 0;
+  }
+  size_t n_spilled = compact_active(NULL, keep, g->n_vertices, spilled);
+  printf("  register allocation: %zu batches, %zu spill candidates, %zu spilled\n", n_batches, n_candidates, n_spilled);
+  ctx->rounds = n_batches;
+  free(degree_left);
+  free(stack);
+  free(batch_start);
+  return n_spilled;
+}
+
+// === dynamic_graph implementation ===
+
+static void vertex_list_push(struct vertex_list *l, const number_t v) {
+  if (l->size == l->capacity) {
+    l->capacity = l->capacity > 0 ? 2 * l->capacity : 4;
+    l->items = realloc(l->items, l->capacity * sizeof(number_t));
+    assert(l->items != NULL);
+  }
+  l->items[l->size++] = v;
+}
+
+static bool vertex_list_contains(const struct vertex_list *l, const number_t v) {
+  for (size_t i = 0; i < l->size; i++) {
+    if (l->items[i] == v) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Removes v (order is not kept); returns whether it was there.
+static bool vertex_list_remove(struct vertex_list *l, const number_t v) {
+  for (size_t i = 0; i < l->size; i++) {
+    if (l->items[i] == v) {
+      l->items[i] = l->items[--l->size];
+      return true;
+    }
+  }
+  return false;
+}
+
+// Grows every per-vertex array to hold at least n vertices.
+static void dynamic_graph_reserve(struct dynamic_graph *dg, const size_t n) {
+  if (n <= dg->capacity) {
+    return;
+  }
+  size_t capacity = dg->capacity > 0 ? dg->capacity : 1;
+  while (capacity < n) {
+    capacity *= 2;
+  }
+  dg->added = realloc(dg->added, capacity * sizeof(struct vertex_list));
+  dg->deleted = realloc(dg->deleted, capacity * sizeof(struct vertex_list));
+  dg->degree = realloc(dg->degree, capacity * sizeof(size_t));
+  dg->c.colors = realloc(dg->c.colors, capacity * sizeof(color_t));
+  dg->removed = realloc(dg->removed, VSET_WORDS(capacity) * sizeof(uint64_t));
+  dg->dirty_set = realloc(dg->dirty_set, VSET_WORDS(capacity) * sizeof(uint64_t));
+  assert(dg->added != NULL && dg->deleted != NULL && dg->degree != NULL && dg->c.colors != NULL && dg->removed != NULL && dg->dirty_set != NULL);
+  for (size_t i = dg->capacity; i < capacity; i++) {
+    dg->added[i] = (struct vertex_list) { 0 };
+    dg->deleted[i] = (struct vertex_list) { 0 };
+    dg->degree[i] = 0;
+    dg->c.colors[i] = 0;
+  }
+  for (size_t w = VSET_WORDS(dg->capacity); w < VSET_WORDS(capacity); w++) {
+    dg->removed[w] = 0;
+    dg->dirty_set[w] = 0;
+  }
+  dg->capacity = capacity;
+}
+
+static void dynamic_graph_mark(struct dynamic_graph *dg, const number_t u) {
+  if (!vset_test(dg->dirty_set, u)) {
+    vset_add(dg->dirty_set, u);
+    vertex_list_push(&dg->dirty, u);
+  }
+}
+
+// Runs through the live neighbors of u: the base row minus deleted edges and
+// vertices, then the inserted edges.
+struct dynamic_neighbor_iter {
+  const struct dynamic_graph *dg;
+  number_t u;
+  size_t next_base;
+  size_t end_base;
+  size_t next_added;
+};
+
+static inline void dynamic_neighbors(const struct dynamic_graph *dg, const number_t u, struct dynamic_neighbor_iter *it) {
+  it->dg = dg;
+  it->u = u;
+  it->next_added = 0;
+  if (u < dg->base->n_vertices) {
+    it->next_base = dg->base->row_index[u];
+    it->end_base = dg->base->row_index[u + 1];
+  } else {
+    it->next_base = 0;
+    it->end_base = 0;
+  }
+}
+
+static inline bool dynamic_neighbor_next(struct dynamic_neighbor_iter *it, number_t *v) {
+  const struct dynamic_graph *dg = it->dg;
+  while (it->next_base < it->end_base) {
+    *v = dg->base->col_index[it->next_base++];
+    if (!vset_test(dg->removed, *v) && !vertex_list_contains(&dg->deleted[it->u], *v)) {
+      return true;
+    }
+  }
+  while (it->next_added < dg->added[it->u].size) {
+    *v = dg->added[it->u].items[it->next_added++];
+    if (!vset_test(dg->removed, *v)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool dynamic_graph_in_base(const struct dynamic_graph *dg, const number_t u, const number_t v) {
+  return u < dg->base->n_vertices && v < dg->base->n_vertices && matrix_query(dg->base, u, v);
+}
+
+struct dynamic_graph *dynamic_graph_create(const struct matrix *base, const struct coloring *c) {
+  assert(c->colors_size == base->n_vertices);
+  struct dynamic_graph *dg = calloc(1, sizeof(struct dynamic_graph));
+  if (dg == NULL) {
+    return NULL;
+  }
+  dg->base = base;
+  dg->n_vertices = base->n_vertices;
+  dynamic_graph_reserve(dg, base->n_vertices);
+  memcpy(dg->c.colors, c->colors, base->n_vertices * sizeof(color_t));
+  dg->c.colors_size = base->n_vertices;
+  size_t max_degree = 0;
+#pragma omp parallel for schedule(static) reduction(max:max_degree)
+  for (size_t i = 0; i < base->n_vertices; i++) {
+    dg->degree[i] = base->row_index[i + 1] - base->row_index[i];
+    if (dg->degree[i] > max_degree) {
+      max_degree = dg->degree[i];
+    }
+  }
+  dg->max_degree = max_degree;
+  return dg;
+}
+
+void dynamic_graph_destroy(struct dynamic_graph *dg) {
+  if (dg == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < dg->capacity; i++) {
+    free(dg->added[i].items);
+    free(dg->deleted[i].items);
+  }
+  free(dg->added);
+  free(dg->deleted);
+  free(dg->removed);
+  free(dg->degree);
+  free(dg->c.colors);
+  free(dg->dirty.items);
+  free(dg->dirty_set);
+  free(dg);
+}
+
+number_t dynamic_graph_insert_vertices(struct dynamic_graph *dg, const size_t count) {
+  number_t first = dg->n_vertices;
+  assert(dg->n_vertices + count <= NUMBER_MAX);
+  dynamic_graph_reserve(dg, dg->n_vertices + count);
+  dg->n_vertices += count;
+  dg->c.colors_size = dg->n_vertices;
+  for (size_t i = first; i < dg->n_vertices; i++) {
+    dynamic_graph_mark(dg, i);
+  }
+  return first;
+}
+
+void dynamic_graph_delete_vertices(struct dynamic_graph *dg, const number_t *vertices, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    number_t u = vertices[i];
+    assert(u < dg->n_vertices);
+    if (vset_test(dg->removed, u)) {
+      continue;
+    }
+    // the neighbors may now take a lower color
+    struct dynamic_neighbor_iter it;
+    number_t v;
+    for (dynamic_neighbors(dg, u, &it); dynamic_neighbor_next(&it, &v);) {
+      dynamic_graph_mark(dg, v);
+    }
+    vset_add(dg->removed, u);
+    dg->c.colors[u] = 0;
+  }
+}
+
+void dynamic_graph_insert_edges(struct dynamic_graph *dg, const struct matrix_al_pair *edges, const size_t n) {
+  for (size_t e = 0; e < n; e++) {
+    number_t u = edges[e].i;
+    number_t v = edges[e].j;
+    assert(u < dg->n_vertices && v < dg->n_vertices);
+    if (u == v || vset_test(dg->removed, u) || vset_test(dg->removed, v) || vertex_list_contains(&dg->added[u], v)) {
+      continue;
+    }
+    if (dynamic_graph_in_base(dg, u, v)) {
+      if (!vertex_list_remove(&dg->deleted[u], v)) {
+        continue;
+      }
+      vertex_list_remove(&dg->deleted[v], u);
+    } else {
+      vertex_list_push(&dg->added[u], v);
+      vertex_list_push(&dg->added[v], u);
+    }
+    dg->degree[u]++;
+    dg->degree[v]++;
+    dg->max_degree = dg->degree[u] > dg->max_degree ? dg->degree[u] : dg->max_degree;
+    dg->max_degree = dg->degree[v] > dg->max_degree ? dg->degree[v] : dg->max_degree;
+    // of the two ends of a clash, recoloring one is enough
+    if (dg->c.colors[u] == dg->c.colors[v]) {
+      dynamic_graph_mark(dg, u > v ? u : v);
+    }
+  }
+}
+
+void dynamic_graph_delete_edges(struct dynamic_graph *dg, const struct matrix_al_pair *edges, const size_t n) {
+  for (size_t e = 0; e < n; e++) {
+    number_t u = edges[e].i;
+    number_t v = edges[e].j;
+    assert(u < dg->n_vertices && v < dg->n_vertices);
+    if (vset_test(dg->removed, u) || vset_test(dg->removed, v)) {
+      continue;
+    }
+    if (vertex_list_remove(&dg->added[u], v)) {
+      vertex_list_remove(&dg->added[v], u);
+    } else if (dynamic_graph_in_base(dg, u, v) && !vertex_list_contains(&dg->deleted[u], v)) {
+      vertex_list_push(&dg->deleted[u], v);
+      vertex_list_push(&dg->deleted[v], u);
+    } else {
+      continue;
+    }
+    dg->degree[u]--;
+    dg->degree[v]--;
+    // either end may now take a lower color
+    dynamic_graph_mark(dg, u);
+    dynamic_graph_mark(dg, v);
+  }
+}
+
+// Returns the smallest color (from 1) that no live neighbor of u has.
+// forbidden has max_degree + 2 entries; a color is taken when its entry is
+// epoch, which is fresh for every call, as in color_distance2.
+static color_t dynamic_smallest_free_color(const struct dynamic_graph *dg, const number_t u, size_t *forbidden, const size_t epoch) {
+  struct dynamic_neighbor_iter it;
+  number_t v;
+  for (dynamic_neighbors(dg, u, &it); dynamic_neighbor_next(&it, &v);) {
+    color_t color = __atomic_load_n(&dg->c.colors[v], __ATOMIC_RELAXED);
+    if (color <= dg->max_degree + 1) {
+      forbidden[color] = epoch;
+    }
+  }
+  color_t color = 1;
+  while (forbidden[color] == epoch) {
+    color++;
+  }
+  assert(color <= dg->max_degree + 1);
+  return color;
+}
+
+size_t dynamic_graph_recolor(struct dynamic_graph *dg) {
+  assert(dg->max_degree < COLOR_MAX);
+  const size_t n_dirty = dg->dirty.size;
+  const int n_threads = omp_get_max_threads();
+  number_t *active = malloc((n_dirty + 1) * sizeof(number_t));
+  number_t *next = malloc((n_dirty + 1) * sizeof(number_t));
+  offset_t *keep = malloc((n_dirty + 1) * sizeof(offset_t));
+  size_t *forbidden = calloc(n_threads * (dg->max_degree + 2), sizeof(size_t));
+  size_t *epoch = calloc(n_threads, sizeof(size_t));
+  assert(active != NULL && next != NULL && keep != NULL && forbidden != NULL && epoch != NULL);
+  size_t n_active = 0;
+  for (size_t d = 0; d < n_dirty; d++) {
+    number_t u = dg->dirty.items[d];
+    vset_remove(dg->dirty_set, u);
+    if (!vset_test(dg->removed, u)) {
+      dg->c.colors[u] = 0;
+      active[n_active++] = u;
+    }
+  }
+  dg->dirty.size = 0;
+  const size_t n_recolored = n_active;
+
+  size_t rounds = 0;
+  while (n_active > 0) {
+#pragma omp parallel
+    {
+    size_t *thread_forbidden = forbidden + omp_get_thread_num() * (dg->max_degree + 2);
+    size_t *thread_epoch = &epoch[omp_get_thread_num()];
+#pragma omp for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      __atomic_store_n(&dg->c.colors[active[a]], dynamic_smallest_free_color(dg, active[a], thread_forbidden, ++*thread_epoch), __ATOMIC_RELAXED);
+    }
+    }
+    // the vertices outside the batch keep their colors, so clashes are
+    // between batch vertices; the higher id goes again
+#pragma omp parallel for schedule(static)
+    for (size_t a = 0; a < n_active; a++) {
+      number_t u = active[a];
+      keep[a] = 0;
+      struct dynamic_neighbor_iter it;
+      number_t v;
+      for (dynamic_neighbors(dg, u, &it); dynamic_neighbor_next(&it, &v);) {
+        if (v < u && dg->c.colors[v] == dg->c.colors[u]) {
+          keep[a] = 1;
+          break;
+        }
+      }
+    }
+    n_active = compact_active(active, keep, n_active, next);
+    number_t *tmp = active;
+    active = next;
+    next = tmp;
+    rounds++;
+  }
+  printf("  dynamic recolor: %zu vertices in %zu rounds\n", n_recolored, rounds);
+  free(active);
+  free(next);
+  free(keep);
+  free(forbidden);
+  free(epoch);
+  return n_recolored;
+}
+
+struct matrix *dynamic_graph_snapshot(const struct dynamic_graph *dg) {
+  size_t n_edges = 0;
+  for (size_t u = 0; u < dg->n_vertices; u++) {
+    if (!vset_test(dg->removed, u)) {
+      n_edges += dg->degree[u];
+    }
+  }
+  // degree counts removed neighbors too, so this is an upper bound
+  struct matrix_al_pair *edges = malloc((n_edges / 2 + 1) * sizeof(struct matrix_al_pair));
+  if (edges == NULL) {
+    return NULL;
+  }
+  n_edges = 0;
+  for (size_t u = 0; u < dg->n_vertices; u++) {
+    if (vset_test(dg->removed, u)) {
+      continue;
+    }
+    struct dynamic_neighbor_iter it;
+    number_t v;
+    for (dynamic_neighbors(dg, u, &it); dynamic_neighbor_next(&it, &v);) {
+      if (u < v) {
+        edges[n_edges++] = (struct matrix_al_pair) { .i = u, .j = v };
+      }
+    }
+  }
+  struct matrix *m = matrix_create_from_edges(dg->n_vertices, edges, n_edges);
+  free(edges);
+  return m;
+}
+
+// === color_batch implementation ===
+
+// One thread's scratch for coloring small graphs serially, sized for the
+// largest of them and reused across graphs.
+struct batch_pool {
+  number_t *order;  // n_vertices elements
+  offset_t *count;  // max_degree + 2 elements
+  size_t *stamp;    // max_degree + 2 elements
+  size_t epoch;     // stamp[color] == epoch marks color as taken
+};
+
+// Colors g greedily, largest degree first (by counting sort), on one thread.
+static void color_batch_serial(const struct matrix *g, struct coloring *c, struct batch_pool *pool) {
+  size_t max_degree = 0;
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    size_t degree = g->row_index[i + 1] - g->row_index[i];
+    max_degree = degree > max_degree ? degree : max_degree;
+    c->colors[i] = 0;
+  }
+  // descending degree: vertices of degree d go after those of degree > d
+  memset(pool->count, 0, (max_degree + 2) * sizeof(offset_t));
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    pool->count[max_degree - (g->row_index[i + 1] - g->row_index[i]) + 1]++;
+  }
+  for (size_t d = 0; d <= max_degree; d++) {
+    pool->count[d + 1] += pool->count[d];
+  }
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    pool->order[pool->count[max_degree - (g->row_index[i + 1] - g->row_index[i])]++] = i;
+  }
+  for (size_t i = 0; i < g->n_vertices; i++) {
+    number_t u = pool->order[i];
+    pool->epoch++;
+    for (size_t j = g->row_index[u]; j < g->row_index[u + 1]; j++) {
+      number_t v = g->col_index[j];
+      if (c->colors[v] <= max_degree + 1) {
+        pool->stamp[c->colors[v]] = pool->epoch;
+      }
+    }
+    color_t color = 1;
+    while (pool->stamp[color] == pool->epoch) {
+      color++;
+    }
+    c->colors[u] = color;
+  }
+}
+
+size_t color_batch(const struct matrix *const *graphs, struct coloring *colorings, const size_t n_graphs, const size_t outlier_vertices, const uint64_t seed) {
+  // small graphs go largest first, so that the last ones handed out are short
+  size_t *small = malloc((n_graphs + 1) * sizeof(size_t));
+  size_t *nnz = malloc((n_graphs + 1) * sizeof(size_t));
+  assert(small != NULL && nnz != NULL);
+  size_t n_small = 0;
+  size_t max_vertices = 0;
+  size_t max_degree = 0;
+  for (size_t b = 0; b < n_graphs; b++) {
+    const struct matrix *g = graphs[b];
+    assert(colorings[b].colors_size == g->n_vertices);
+    nnz[b] = g->row_index[g->n_vertices];
+    if (g->n_vertices > outlier_vertices) {
+      continue;
+    }
+    small[n_small++] = b;
+    max_vertices = g->n_vertices > max_vertices ? g->n_vertices : max_vertices;
+    for (size_t i = 0; i < g->n_vertices; i++) {
+      size_t degree = g->row_index[i + 1] - g->row_index[i];
+      max_degree = degree > max_degree ? degree : max_degree;
+    }
+  }
+  assert(max_degree < COLOR_MAX);
+  qsort_r(small, n_small, sizeof(size_t), qsort_compar2, nnz);
+
+  // graph-level parallelism: each thread takes the next graph when it is
+  // done with one, coloring it serially with its own pool
+#pragma omp parallel
+  {
+  struct batch_pool pool = {
+    .order = malloc((max_vertices + 1) * sizeof(number_t)),
+    .count = malloc((max_degree + 2) * sizeof(offset_t)),
+    .stamp = calloc(max_degree + 2, sizeof(size_t)),
+    .epoch = 0,
+  };
+  assert(pool.order != NULL && pool.count != NULL && pool.stamp != NULL);
+#pragma omp for schedule(dynamic, 1)
+  for (size_t s = 0; s < n_small; s++) {
+    size_t b = small[n_small - 1 - s];
+    color_batch_serial(graphs[b], &colorings[b], &pool);
+  }
+  free(pool.order);
+  free(pool.count);
+  free(pool.stamp);
+  }
+
+  // outliers are worth intra-graph parallelism, one at a time
+  size_t n_outliers = 0;
+  for (size_t b = 0; b < n_graphs; b++) {
+    if (graphs[b]->n_vertices <= outlier_vertices) {
+      continue;
+    }
+    struct solver_context *ctx = solver_context_create(graphs[b]);
+    assert(ctx != NULL);
+    color_jones_plassmann(ctx, &colorings[b], true, seed);
+    solver_context_destroy(ctx);
+    n_outliers++;
+  }
+  free(small);
+  free(nnz);
+  return n_outliers;
+}
+
+// === color_semi_external implementation ===
+
+// Reads size bytes at offset, retrying short reads. Returns 0 on success.
+static int read_fully(const int fd, void *buf, size_t size, off_t offset) {
+  char *p = buf;
+  while (size > 0) {
+    ssize_t n = pread(fd, p, size, offset);
+    if (n <= 0) {
+      return 1;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+int color_semi_external(const char *path, struct coloring *c, const size_t block_bytes) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  // the same checks as matrix_open_mmap, except that the column ids are
+  // checked block by block as they are streamed
+  struct stat st;
+  struct matrix_file_header header;
+  if (fstat(fd, &st) != 0 ||
+      read_fully(fd, &header, sizeof(header), 0) != 0 ||
+      !matrix_file_header_valid(&header, st.st_size)) {
+    close(fd);
+    return 1;
+  }
+  const size_t n = header.n_vertices;
+  const off_t col_index_offset = matrix_file_col_index_offset(n, sizeof(offset_t));
+
+  // per-vertex state stays in memory: the row offsets (i.e. the degrees),
+  // the colors and the vertices still to color
+  offset_t *row_index = malloc((n + 1) * sizeof(offset_t));
+  c->colors = calloc(n, sizeof(color_t));
+  c->colors_size = n;
+  uint64_t *pending = vset_create(n);
+  uint64_t *retry = vset_create(n);
+  // rows [block_row[b], block_row[b + 1]) form block b
+  number_t *block_row = malloc((n + 2) * sizeof(number_t));
+  if (row_index == NULL || c->colors == NULL || pending == NULL || retry == NULL || block_row == NULL ||
+      read_fully(fd, row_index, (n + 1) * sizeof(offset_t), sizeof(header)) != 0) {
+    free(row_index);
+    free(c->colors);
+    free(pending);
+    free(retry);
+    free(block_row);
+    close(fd);
+    return 1;
+  }
+  // the blocks are cut and read by these offsets
+  if (!matrix_file_row_index_valid(row_index, n, header.nnz)) {
+    free(row_index);
+    free(c->colors);
+    free(pending);
+    free(retry);
+    free(block_row);
+    close(fd);
+    return 1;
+  }
+  // whole rows go into blocks of about block_bytes; a longer row is a block
+  // by itself
+  size_t n_blocks = 0;
+  size_t max_block = 0;
+  size_t max_degree = 0;
+  block_row[0] = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t degree = row_index[i + 1] - row_index[i];
+    max_degree = degree > max_degree ? degree : max_degree;
+    if (i > block_row[n_blocks] && (row_index[i + 1] - row_index[block_row[n_blocks]]) * sizeof(number_t) > block_bytes) {
+      block_row[++n_blocks] = i;
+    }
+  }
+  block_row[++n_blocks] = n;
+  for (size_t b = 0; b < n_blocks; b++) {
+    size_t bytes = (row_index[block_row[b + 1]] - row_index[block_row[b]]) * sizeof(number_t);
+    max_block = bytes > max_block ? bytes : max_block;
+  }
+  assert(max_degree < COLOR_MAX);
+  const int n_threads = omp_get_max_threads();
+  number_t *buffer = malloc(max_block + sizeof(number_t));
+  bool *forbidden = calloc(n_threads * (max_degree + 2), sizeof(bool));
+  if (buffer == NULL || forbidden == NULL) {
+    free(row_index);
+    free(c->colors);
+    free(pending);
+    free(retry);
+    free(block_row);
+    free(buffer);
+    free(forbidden);
+    close(fd);
+    return 1;
+  }
+#pragma omp parallel for schedule(static)
+  for (size_t w = 0; w < VSET_WORDS(n); w++) {
+    pending[w] = ~(uint64_t) 0;
+  }
+  if (n % 64 != 0) {
+    pending[n / 64] &= (UINT64_C(1) << (n % 64)) - 1;
+  }
+
+  // Each pass streams the blocks that still have pending vertices, in file
+  // order. A block's pending vertices are colored speculatively in parallel
+  // against the colors in memory; a vertex that then clashes with a lower
+  // neighbor of the same block stays pending for the next pass. Vertices of
+  // other blocks are never colored concurrently with them, so that is the
+  // only way to clash.
+  int status = 0;
+  size_t n_pending = n;
+  for (size_t pass = 1; n_pending > 0 && status == 0; pass++) {
+    size_t bytes_read = 0;
+    size_t blocks_read = 0;
+    size_t colored = 0;
+    size_t conflicts = 0;
+    for (size_t b = 0; b < n_blocks && status == 0; b++) {
+      const number_t first = block_row[b];
+      const number_t end = block_row[b + 1];
+      bool any = false;
+      for (size_t i = first; i < end && !any; i++) {
+        any = vset_test(pending, i);
+      }
+      if (!any) {
+        continue;
+      }
+      const size_t bytes = (row_index[end] - row_index[first]) * sizeof(number_t);
+      if (read_fully(fd, buffer, bytes, col_index_offset + row_index[first] * sizeof(number_t)) != 0) {
+        status = 1;
+        break;
+      }
+      bytes_read += bytes;
+      blocks_read++;
+      // a column id past the last vertex means the file is corrupt
+      bool corrupt = false;
+#pragma omp parallel for schedule(static) reduction(||:corrupt)
+      for (size_t j = 0; j < bytes / sizeof(number_t); j++) {
+        corrupt = corrupt || buffer[j] >= n;
+      }
+      if (corrupt) {
+        status = 1;
+        break;
+      }
+#pragma omp parallel reduction(+:colored)
+      {
+      bool *thread_forbidden = forbidden + omp_get_thread_num() * (max_degree + 2);
+#pragma omp for schedule(static)
+      for (size_t u = first; u < end; u++) {
+        if (!vset_test(pending, u)) {
+          continue;
+        }
+        const number_t *row = buffer + (row_index[u] - row_index[first]);
+        const size_t degree = row_index[u + 1] - row_index[u];
+        for (size_t j = 0; j < degree; j++) {
+          color_t color = __atomic_load_n(&c->colors[row[j]], __ATOMIC_RELAXED);
+          if (color <= degree + 1) {
+            thread_forbidden[color] = true;
+          }
+        }
+        color_t color = 1;
+        while (thread_forbidden[color]) {
+          color++;
+        }
+        memset(thread_forbidden, 0, (degree + 2) * sizeof(bool));
+        __atomic_store_n(&c->colors[u], color, __ATOMIC_RELAXED);
+        colored++;
+      }
+      }
+#pragma omp parallel for schedule(static) reduction(+:conflicts)
+      for (size_t u = first; u < end; u++) {
+        if (!vset_test(pending, u)) {
+          continue;
+        }
+        const number_t *row = buffer + (row_index[u] - row_index[first]);
+        const size_t degree = row_index[u + 1] - row_index[u];
+        for (size_t j = 0; j < degree; j++) {
+          number_t v = row[j];
+          if (v >= first && v < u && vset_test(pending, v) && c->colors[v] == c->colors[u]) {
+            vset_add_atomic(retry, u);
+            conflicts++;
+            break;
+          }
+        }
+      }
+      // only now that every clash in the block is decided
+#pragma omp parallel for schedule(static)
+      for (size_t u = first; u < end; u++) {
+        if (vset_test(retry, u)) {
+          vset_remove_atomic(retry, u);
+        } else if (vset_test(pending, u)) {
+          vset_remove_atomic(pending, u);
+        }
+      }
+    }
+    n_pending = vset_count(pending, n);
+    printf("  semi-external pass %zu: %zu of %zu blocks, %zu bytes read, %zu colored, %zu conflicts\n", pass, blocks_read, n_blocks, bytes_read, colored, conflicts);
+  }
+  free(row_index);
+  free(pending);
+  free(retry);
+  free(block_row);
+  free(buffer);
+  free(forbidden);
+  close(fd);
+  if (status != 0) {
+    free(c->colors);
+  }
+  return status;
+}
+
+// === engine selection ===
+
+static const char *solver_engine_names[] = {
+  [SOLVER_LUBY] = "luby",
+  [SOLVER_JP] = "jp",
+  [SOLVER_LDF] = "ldf",
+  [SOLVER_SPECULATIVE] = "greedy",
+  [SOLVER_SMALLEST_LAST] = "sl",
+  [SOLVER_CHORDAL] = "chordal",
+  [SOLVER_DISTANCE2] = "d2",
+};
+
+int solver_engine_parse(const char *name, enum solver_engine *engine) {
+  for (size_t i = 0; i < sizeof(solver_engine_names) / sizeof(solver_engine_names[0]); i++) {
+    if (strcmp(name, solver_engine_names[i]) == 0) {
+      *engine = i;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void solver_color(struct solver_context *ctx, struct coloring *c, const enum solver_engine engine, const size_t k, const uint64_t seed) {
+  switch (engine) {
+  case SOLVER_LUBY:
+    color_cliquelike(ctx, c, k, NULL, seed);
+    break;
+  case SOLVER_JP:
+    color_jones_plassmann(ctx, c, false, seed);
+    break;
+  case SOLVER_LDF:
+    color_jones_plassmann(ctx, c, true, seed);
+    break;
+  case SOLVER_SPECULATIVE:
+    color_speculative_greedy(ctx, c);
+    break;
+  case SOLVER_SMALLEST_LAST:
+    color_smallest_last(ctx, c);
+    break;
+  case SOLVER_CHORDAL:
+    color_chordal(ctx, c, seed);
+    break;
+  case SOLVER_DISTANCE2:
+    color_distance2(ctx, c);
+    break;
+  }
+}
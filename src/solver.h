@@ -1,8 +1,186 @@
 #pragma once
 #include "graph.h"
 
-size_t luby_maximal_independent_set(const struct matrix *g, struct coloring *c, const number_t color, bool *initial_s);
+// Scratch space for the solver on one graph: the cached degrees and every
+// buffer Luby's rounds need, allocated and first-touched once so that no
+// color or round allocates. Engines that need other scratch allocate it once
+// per call.
+struct solver_context {
+  const struct matrix *g;
+  size_t *degree;       // n_vertices elements
+  uint64_t *s;          // vertex set, empty between calls
+  uint64_t *initial_s;  // vertex set, empty between calls
+  uint64_t *visited;    // vertex set
+  number_t *active;     // n_vertices elements (Luby's worklist, or a traversal stack)
+  number_t *next;       // n_vertices elements
+  offset_t *keep;       // n_vertices + 1 elements
+  size_t *constrained;  // constrained_size elements, grown by color_cliquelike
+  size_t constrained_size;
+  size_t max_degree;
+  int n_threads;        // omp_get_max_threads() at creation
+  bool *forbidden;      // n_threads * (max_degree + 2) elements, all false between calls
+  size_t rounds;        // parallel rounds taken by the last coloring
+};
 
-struct subgraph *detect_subgraph(const struct matrix *g, const size_t k, size_t *subgraphs_length);
+// Returns a context for coloring g, or NULL. g must outlive it.
+struct solver_context *solver_context_create(const struct matrix *g);
 
-void color_cliquelike(const struct matrix *g, struct coloring *c, const size_t k, bool *selection);
+void solver_context_destroy(struct solver_context *ctx);
+
+// Random choices are drawn from hash64 of (seed, round, vertex), so they do
+// not depend on the number of threads.
+size_t luby_maximal_independent_set(struct solver_context *ctx, struct coloring *c, const color_t color, const uint64_t *initial_s, const uint64_t seed);
+
+struct subgraph *detect_subgraph(struct solver_context *ctx, const size_t k, size_t *subgraphs_length);
+
+void color_cliquelike(struct solver_context *ctx, struct coloring *c, const size_t k, const uint64_t *selection, const uint64_t seed);
+
+// Colors every vertex of ctx->g in parallel rounds: a vertex takes the
+// smallest color missing among its neighbors once all neighbors of higher
+// priority are colored. Priorities are random from seed, or, with
+// largest_degree_first, by degree first (LDF). Uses at most max_degree + 1
+// colors.
+void color_jones_plassmann(struct solver_context *ctx, struct coloring *c, const bool largest_degree_first, const uint64_t seed);
+
+// Colors ctx->g greedily in smallest-last order, i.e. the reverse of
+// matrix_degeneracy_order (which runs in parallel; the greedy pass does not).
+// Uses at most degeneracy + 1 colors; returns the degeneracy.
+size_t color_smallest_last(struct solver_context *ctx, struct coloring *c);
+
+// If ctx->g is chordal (checked with maximum cardinality search, O(n + nnz)),
+// colors it optimally by a greedy pass in MCS order and returns true.
+// Otherwise falls back to color_jones_plassmann (LDF) and returns false.
+bool color_chordal(struct solver_context *ctx, struct coloring *c, const uint64_t seed);
+
+// Colors every vertex of ctx->g optimistically: each round colors the
+// worklist greedily in parallel against the neighbors' current colors, then
+// puts the vertices that clash with a lower-id neighbor back on the worklist.
+// Prints the conflicts of every round. Uses at most max_degree + 1 colors;
+// the result depends on thread timing.
+void color_speculative_greedy(struct solver_context *ctx, struct coloring *c);
+
+// Colors ctx->g so that vertices within distance 2 get different colors, as
+// needed to compress sparse Jacobians, by walking the CSR two hops deep
+// rather than forming the square of the graph. Speculative like
+// color_speculative_greedy, with per-thread forbidden-color scratch; prints
+// the conflicts of every round. Check with matrix_verify_distance2_coloring.
+void color_distance2(struct solver_context *ctx, struct coloring *c);
+
+// Refines the coloring c of ctx->g by Culberson's iterated greedy:
+// each iteration orders the color classes (reverse, largest first or random
+// from seed, in turn) and recolors them greedily, one class at a time with
+// its vertices in parallel. This never uses more colors. Stops after
+// max_iterations, or once time_budget seconds have passed if it is positive.
+// Prints the color count before and after, and returns the latter. c must be
+// complete: a vertex of color 0 fails an assert.
+color_t color_iterated_greedy(struct solver_context *ctx, struct coloring *c, const size_t max_iterations, const double time_budget, const uint64_t seed);
+
+// Evens out the class sizes of the coloring c of ctx->g toward
+// ceil(colored / k) without adding colors. Each round, about the excess of
+// every oversized class, picked by hash from seed, moves in parallel to an
+// undersized color its neighbors do not have. Adjacent vertices never pick
+// the same color, and no color takes more than its deficit, so c stays valid.
+// Which movers fill a deficit depends on thread timing. Stops after
+// max_rounds or when nothing moves. Prints the smallest and largest class
+// before and after, and returns their final difference.
+size_t color_balance(struct solver_context *ctx, struct coloring *c, const size_t max_rounds, const uint64_t seed);
+
+// Colors ctx->g with at most k colors (registers) by Chaitin-Briggs
+// simplify/select. Simplify removes all vertices of remaining degree below k
+// in parallel batches; when none is left, the vertices with the lowest
+// spill_cost per remaining neighbor among their neighbors become spill
+// candidates. Select colors the batches in reverse, speculatively in parallel,
+// and leaves candidates with no free color uncolored (0). Writes the spilled
+// vertices, in increasing order, to spilled (n_vertices elements) and returns
+// how many there are.
+size_t color_register_allocation(struct solver_context *ctx, struct coloring *c, const size_t k, const double *spill_cost, number_t *spilled);
+
+// A growable list of vertices.
+struct vertex_list {
+  number_t *items;
+  size_t size;
+  size_t capacity;
+};
+
+// A graph that changes in batches, with its coloring: an immutable base CSR
+// plus, per vertex, the neighbors inserted and the base neighbors deleted
+// since. Updates note the vertices whose color clashes or could now be lower,
+// and dynamic_graph_recolor repairs only those, so its cost follows the
+// batches rather than the graph.
+struct dynamic_graph {
+  const struct matrix *base;   // must outlive the dynamic graph
+  size_t n_vertices;           // base vertices, then inserted ones
+  size_t capacity;             // vertices allocated in the per-vertex arrays
+  struct vertex_list *added;   // capacity elements
+  struct vertex_list *deleted; // capacity elements
+  uint64_t *removed;           // vertex set of deleted vertices
+  size_t *degree;              // capacity elements, counting removed neighbors
+  size_t max_degree;           // an upper bound, never lowered
+  struct coloring c;           // colors_size is n_vertices; removed vertices have 0
+  struct vertex_list dirty;    // vertices to recolor
+  uint64_t *dirty_set;         // vertex set of dirty
+};
+
+// Starts from base colored by c (copied, and valid), or NULL on error.
+struct dynamic_graph *dynamic_graph_create(const struct matrix *base, const struct coloring *c);
+
+void dynamic_graph_destroy(struct dynamic_graph *dg);
+
+// Appends count isolated, uncolored vertices; returns the first one's id.
+number_t dynamic_graph_insert_vertices(struct dynamic_graph *dg, const size_t count);
+
+// Deletes vertices with their edges; ids are not reused.
+void dynamic_graph_delete_vertices(struct dynamic_graph *dg, const number_t *vertices, const size_t n);
+
+// Edges that exist already, loops and edges of deleted vertices are ignored.
+void dynamic_graph_insert_edges(struct dynamic_graph *dg, const struct matrix_al_pair *edges, const size_t n);
+
+// Edges that do not exist are ignored.
+void dynamic_graph_delete_edges(struct dynamic_graph *dg, const struct matrix_al_pair *edges, const size_t n);
+
+// Recolors the vertices the updates since the last call touched, greedily
+// and speculatively in parallel as in color_speculative_greedy, leaving
+// dg->c valid. Returns how many vertices were recolored.
+size_t dynamic_graph_recolor(struct dynamic_graph *dg);
+
+// Returns the current graph as a CSR (deleted vertices stay as isolated
+// ids), or NULL on error.
+struct matrix *dynamic_graph_snapshot(const struct dynamic_graph *dg);
+
+// Colors many graphs at once: colorings[b] (colors_size n_vertices) gets a
+// coloring of graphs[b]. Graphs of at most outlier_vertices vertices are
+// spread over the threads, largest first, and each colored on one thread,
+// greedily by largest degree first, from per-thread scratch reused across
+// graphs. Larger graphs are then colored one at a time with
+// color_jones_plassmann (LDF) on all threads. Returns the number of those.
+size_t color_batch(const struct matrix *const *graphs, struct coloring *colorings, const size_t n_graphs, const size_t outlier_vertices, const uint64_t seed);
+
+// Colors the graph in a file written by matrix_save without loading its
+// adjacency: only the row offsets, the colors and two vertex sets are kept in
+// memory, and each pass streams the rows in blocks of about block_bytes with
+// sequential reads, skipping blocks with nothing left to color. Each block is
+// colored speculatively in parallel; vertices that clash within the block
+// wait for the next pass. Prints the bytes read per pass. Allocates
+// c->colors (the caller frees it) and returns 0, or 1 if the file cannot be
+// read or is malformed: too short for its header, with row offsets that do
+// not run from 0 to nnz without going back, or with a column id past the
+// last vertex.
+int color_semi_external(const char *path, struct coloring *c, const size_t block_bytes);
+
+enum solver_engine {
+  SOLVER_LUBY,          // color_cliquelike
+  SOLVER_JP,            // color_jones_plassmann, random priorities
+  SOLVER_LDF,           // color_jones_plassmann, largest degree first
+  SOLVER_SPECULATIVE,   // color_speculative_greedy
+  SOLVER_SMALLEST_LAST, // color_smallest_last
+  SOLVER_CHORDAL,       // color_chordal
+  SOLVER_DISTANCE2,     // color_distance2
+};
+
+// Parses an engine name as the drivers take it (luby, jp, ldf, greedy, sl,
+// chordal or d2). Returns 0 on success.
+int solver_engine_parse(const char *name, enum solver_engine *engine);
+
+// Colors ctx->g with the given engine. k is the number of colors
+// color_cliquelike may use; the other engines pick their own.
+void solver_color(struct solver_context *ctx, struct coloring *c, const enum solver_engine engine, const size_t k, const uint64_t seed);
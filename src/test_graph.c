@@ -1,5 +1,8 @@
 #include <stdlib.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "graph.h"
 
@@ -23,7 +26,7 @@ int main(int argc, char *argv[]) {
 
   struct coloring *c = malloc(sizeof(struct coloring));
   assert(c != NULL);
-  c->colors = calloc(m->n_vertices, sizeof(number_t));
+  c->colors = calloc(m->n_vertices, sizeof(color_t));
   assert(c->colors != NULL);
   c->colors_size = m->n_vertices;
   
@@ -31,17 +34,19 @@ int main(int argc, char *argv[]) {
   matrix_as_dot_color(m, f, c);
   fclose(f);
 
-  bool *select = calloc(m->n_vertices, sizeof(bool));
+  uint64_t *select = vset_create(m->n_vertices);
   assert(select != NULL);
   for (size_t i = 0; i < m->n_vertices; i++) {
-    select[i] = (random() % 2) == 0;
+    if ((random() % 2) == 0) {
+      vset_add(select, i);
+    }
   }
   struct matrix *m2 = matrix_select(m, select);
 
   // verify matrix_select
   for (size_t i = 0; i < m->n_vertices; i++) {
     for (size_t j = 0; j < m->n_vertices; j++) {
-      if (select[i] && select[j]) {
+      if (vset_test(select, i) && vset_test(select, j)) {
         if (matrix_query(m, i, j) != matrix_query(m2, i, j)) {
           printf("matrix_select failed at (%lu, %lu)\n", i, j);
           assert(0);
@@ -50,6 +55,309 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // verify matrix_al_fill_random keeps pairs sorted, so matrix_al_query finds them
+  {
+    struct matrix_al *al = matrix_al_create(0x20, 0x10, malloc);
+    assert(al != NULL);
+    matrix_al_fill_random(al);
+    for (size_t k = 0; k < al->pairs_size; k++) {
+      assert(al->pairs[k].i <= al->pairs[k].j);
+      if (k > 0) {
+        assert(al->pairs[k - 1].i < al->pairs[k].i ||
+               (al->pairs[k - 1].i == al->pairs[k].i && al->pairs[k - 1].j < al->pairs[k].j));
+      }
+      assert(matrix_al_query(al, al->pairs[k].i, al->pairs[k].j));
+    }
+    matrix_al_destroy(al, free);
+  }
+
+  // verify matrix_create_random returns empty graphs when there is nothing to draw
+  {
+    struct matrix *m0 = matrix_create_random(0, 0);
+    assert(m0 != NULL && m0->n_vertices == 0 && m0->nnz == 0);
+    matrix_destroy(m0);
+    m0 = matrix_create_random(5, 0);
+    assert(m0 != NULL && m0->n_vertices == 5 && m0->nnz == 0 && m0->row_index[5] == 0);
+    matrix_destroy(m0);
+  }
+
+  // verify matrix_create_random on dense requests: the complete graph, and
+  // one past half of all pairs, which is drawn through its complement
+  {
+    struct matrix *m0 = matrix_create_random(1000, 1000 * 999 / 2);
+    assert(m0 != NULL && m0->nnz == 1000 * 999);
+    for (size_t i = 0; i < m0->n_vertices; i++) {
+      assert(m0->row_index[i + 1] - m0->row_index[i] == 999);
+    }
+    matrix_destroy(m0);
+    m0 = matrix_create_random(300, 300 * 299 / 4 + 1);
+    assert(m0 != NULL && m0->nnz == 2 * (300 * 299 / 4 + 1));
+    for (size_t i = 0; i < m0->n_vertices; i++) {
+      for (size_t k = m0->row_index[i]; k < m0->row_index[i + 1]; k++) {
+        assert(m0->col_index[k] != i && (k == m0->row_index[i] || m0->col_index[k - 1] < m0->col_index[k]));
+      }
+    }
+    matrix_destroy(m0);
+  }
+
+  // verify matrix_create_from_edges drops duplicates and self-loops
+  {
+    struct matrix_al_pair edges[] = {{3, 1}, {1, 3}, {2, 2}, {0, 3}, {1, 3}, {0, 1}};
+    struct matrix *m3 = matrix_create_from_edges(4, edges, sizeof(edges) / sizeof(edges[0]));
+    assert(m3 != NULL);
+    assert(m3->nnz == 6);
+    offset_t expected_row_index[] = {0, 2, 4, 4, 6};
+    number_t expected_col_index[] = {1, 3, 0, 3, 0, 1};
+    for (size_t i = 0; i <= m3->n_vertices; i++) {
+      assert(m3->row_index[i] == expected_row_index[i]);
+    }
+    for (size_t i = 0; i < m3->nnz; i++) {
+      assert(m3->col_index[i] == expected_col_index[i]);
+    }
+    matrix_destroy(m3);
+  }
+
+  // verify matrix_save and matrix_open_mmap round-trip
+  {
+    char path[] = "/tmp/test_graph_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    int saved = matrix_save(m, path);
+    assert(saved == 0);
+    struct matrix *m4 = matrix_open_mmap(path);
+    assert(m4 != NULL);
+    assert(m4->n_vertices == m->n_vertices);
+    assert(m4->nnz == m->nnz);
+    assert(memcmp(m4->row_index, m->row_index, (m->n_vertices + 1) * sizeof(offset_t)) == 0);
+    assert(memcmp(m4->col_index, m->col_index, m->nnz * sizeof(number_t)) == 0);
+    matrix_destroy(m4);
+
+    // a column id past the last vertex, a row offset going back, an nnz that
+    // overflows the size check, and a file cut short are all rejected; each
+    // is undone before the next
+    const size_t col_index_offset = matrix_file_col_index_offset(m->n_vertices, sizeof(offset_t));
+    const size_t row_1_offset = sizeof(struct matrix_file_header) + sizeof(offset_t);
+    const size_t nnz_offset = offsetof(struct matrix_file_header, nnz);
+    number_t bad_col = m->n_vertices;
+    offset_t bad_row = m->row_index[2] + 1;
+    uint64_t bad_nnz = UINT64_MAX / sizeof(number_t) + 1;
+    uint64_t nnz = m->nnz;
+    fd = open(path, O_WRONLY);
+    assert(fd >= 0);
+    ssize_t written = pwrite(fd, &bad_col, sizeof(number_t), col_index_offset);
+    assert(written == sizeof(number_t));
+    assert(matrix_open_mmap(path) == NULL);
+    written = pwrite(fd, &m->col_index[0], sizeof(number_t), col_index_offset);
+    assert(written == sizeof(number_t));
+    written = pwrite(fd, &bad_row, sizeof(offset_t), row_1_offset);
+    assert(written == sizeof(offset_t));
+    assert(matrix_open_mmap(path) == NULL);
+    written = pwrite(fd, &m->row_index[1], sizeof(offset_t), row_1_offset);
+    assert(written == sizeof(offset_t));
+    written = pwrite(fd, &bad_nnz, sizeof(uint64_t), nnz_offset);
+    assert(written == sizeof(uint64_t));
+    assert(matrix_open_mmap(path) == NULL);
+    written = pwrite(fd, &nnz, sizeof(uint64_t), nnz_offset);
+    assert(written == sizeof(uint64_t));
+    m4 = matrix_open_mmap(path);
+    assert(m4 != NULL);
+    matrix_destroy(m4);
+    int truncated = ftruncate(fd, col_index_offset + (m->nnz - 1) * sizeof(number_t));
+    assert(truncated == 0);
+    assert(matrix_open_mmap(path) == NULL);
+    close(fd);
+    unlink(path);
+  }
+
+  // verify matrix_load on Matrix Market and edge list text
+  {
+    const char *texts[] = {
+      "%%MatrixMarket matrix coordinate pattern symmetric\n% comment\n5 5 4\n2 1\n4 2\n4\t1\n\n5 4\n",
+      "# comment\n1 0\n3 1\r\n 3 0 \n4 3",
+    };
+    offset_t expected_row_index[] = {0, 2, 4, 4, 7, 8};
+    number_t expected_col_index[] = {1, 3, 0, 3, 0, 1, 4, 3};
+    for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); t++) {
+      char path[] = "/tmp/test_graph_XXXXXX";
+      int fd = mkstemp(path);
+      assert(fd >= 0);
+      ssize_t written = write(fd, texts[t], strlen(texts[t]));
+      assert(written == (ssize_t) strlen(texts[t]));
+      close(fd);
+      struct matrix *m5 = matrix_load(path);
+      assert(m5 != NULL);
+      assert(m5->n_vertices == 5);
+      assert(m5->nnz == 8);
+      for (size_t i = 0; i <= m5->n_vertices; i++) {
+        assert(m5->row_index[i] == expected_row_index[i]);
+      }
+      for (size_t i = 0; i < m5->nnz; i++) {
+        assert(m5->col_index[i] == expected_col_index[i]);
+      }
+      matrix_destroy(m5);
+      unlink(path);
+    }
+    // ids that overflow 64 bits or number_t are rejected rather than wrapped
+    const char *bad[] = {
+      "%%MatrixMarket matrix coordinate pattern symmetric\n99999999999999999999 2 1\n2 1\n",
+      "%%MatrixMarket matrix coordinate pattern symmetric\n18446744073709551615 2 1\n2 1\n",
+      "0 99999999999999999999\n",
+    };
+    for (size_t t = 0; t < sizeof(bad) / sizeof(bad[0]); t++) {
+      char path[] = "/tmp/test_graph_XXXXXX";
+      int fd = mkstemp(path);
+      assert(fd >= 0);
+      ssize_t written = write(fd, bad[t], strlen(bad[t]));
+      assert(written == (ssize_t) strlen(bad[t]));
+      close(fd);
+      assert(matrix_load(path) == NULL);
+      unlink(path);
+    }
+  }
+
+  // verify matrix_induce gives a symmetric relabeled subgraph
+  {
+    number_t *new_vertex = malloc(m->n_vertices * sizeof(number_t));
+    number_t *old_vertex = malloc(m->n_vertices * sizeof(number_t));
+    assert(new_vertex != NULL && old_vertex != NULL);
+    struct matrix *m7 = matrix_induce(m, select, new_vertex, old_vertex);
+    assert(m7 != NULL);
+    for (size_t i = 0; i < m->n_vertices; i++) {
+      if (vset_test(select, i)) {
+        assert(old_vertex[new_vertex[i]] == i);
+      } else {
+        assert(new_vertex[i] == (number_t) -1);
+      }
+    }
+    for (size_t u = 0; u < m7->n_vertices; u++) {
+      for (size_t v = 0; v < m7->n_vertices; v++) {
+        assert(matrix_query(m7, u, v) == matrix_query(m, old_vertex[u], old_vertex[v]));
+      }
+    }
+    matrix_destroy(m7);
+    free(new_vertex);
+    free(old_vertex);
+  }
+
+  // verify matrix_reorder gives a permutation and an isomorphic graph
+  for (int order = MATRIX_ORDER_RCM; order <= MATRIX_ORDER_BFS; order++) {
+    number_t *perm = malloc(m->n_vertices * sizeof(number_t));
+    bool *seen = calloc(m->n_vertices, sizeof(bool));
+    assert(perm != NULL && seen != NULL);
+    struct matrix *m8 = matrix_reorder(m, order, perm);
+    assert(m8 != NULL);
+    assert(m8->nnz == m->nnz);
+    for (size_t u = 0; u < m->n_vertices; u++) {
+      assert(perm[u] < m->n_vertices && !seen[perm[u]]);
+      seen[perm[u]] = true;
+    }
+    for (size_t u = 0; u < m8->n_vertices; u++) {
+      for (size_t v = 0; v < m8->n_vertices; v++) {
+        assert(matrix_query(m8, u, v) == matrix_query(m, perm[u], perm[v]));
+      }
+    }
+    matrix_destroy(m8);
+    free(perm);
+    free(seen);
+  }
+
+  // verify matrix_degeneracy_order on a 5-clique {0..4} with a path 4-5-6-7
+  // hanging off it, that it is chordal while a 4-cycle is not, and that no
+  // vertex has more than degeneracy neighbors removed after it on the random
+  // graph
+  {
+    struct matrix_al_pair edges[] = {
+      {0, 1}, {0, 2}, {0, 3}, {0, 4}, {1, 2}, {1, 3}, {1, 4}, {2, 3}, {2, 4}, {3, 4},
+      {4, 5}, {5, 6}, {6, 7},
+    };
+    struct matrix *m9 = matrix_create_from_edges(8, edges, sizeof(edges) / sizeof(edges[0]));
+    assert(m9 != NULL);
+    number_t order[8];
+    number_t core[8];
+    assert(matrix_degeneracy_order(m9, order, core) == 4);
+    for (size_t i = 0; i < 8; i++) {
+      assert(core[i] == (i <= 4 ? 4 : 1));
+    }
+    matrix_mcs_order(m9, order);
+    assert(matrix_is_reverse_peo(m9, order));
+    struct matrix_al_pair cycle[] = {{0, 1}, {1, 2}, {2, 3}, {3, 0}};
+    struct matrix *m10 = matrix_create_from_edges(4, cycle, 4);
+    assert(m10 != NULL);
+    matrix_mcs_order(m10, order);
+    assert(!matrix_is_reverse_peo(m10, order));
+    matrix_destroy(m10);
+    matrix_destroy(m9);
+
+    number_t *order2 = malloc(m->n_vertices * sizeof(number_t));
+    number_t *position = malloc(m->n_vertices * sizeof(number_t));
+    bool *seen = calloc(m->n_vertices, sizeof(bool));
+    assert(order2 != NULL && position != NULL && seen != NULL);
+    size_t degeneracy = matrix_degeneracy_order(m, order2, NULL);
+    for (size_t i = 0; i < m->n_vertices; i++) {
+      assert(order2[i] < m->n_vertices && !seen[order2[i]]);
+      seen[order2[i]] = true;
+      position[order2[i]] = i;
+    }
+    for (size_t u = 0; u < m->n_vertices; u++) {
+      size_t later = 0;
+      for (size_t j = m->row_index[u]; j < m->row_index[u + 1]; j++) {
+        number_t v = m->col_index[j];
+        later += position[v] > position[u];
+      }
+      assert(later <= degeneracy);
+    }
+    free(order2);
+    free(position);
+    free(seen);
+  }
+
+  // verify matrix_verify_distance2_coloring on the path 0-1-2-3
+  {
+    struct matrix_al_pair path[] = {{0, 1}, {1, 2}, {2, 3}};
+    struct matrix *m11 = matrix_create_from_edges(4, path, 3);
+    assert(m11 != NULL);
+    color_t colors[] = {1, 2, 1, 2};
+    struct coloring c = { .colors = colors, .colors_size = 4 };
+    assert(matrix_verify_coloring(m11, &c, false));
+    assert(!matrix_verify_distance2_coloring(m11, &c));
+    colors[2] = 3;
+    colors[3] = 1;
+    assert(matrix_verify_distance2_coloring(m11, &c));
+    matrix_destroy(m11);
+  }
+
+  // verify vertex set operations, including a size that ends mid-word
+  {
+    const size_t n = 200;
+    uint64_t *a = vset_create(n);
+    uint64_t *b = vset_create(n);
+    assert(a != NULL && b != NULL);
+#pragma omp parallel for
+    for (size_t i = 0; i < n; i++) {
+      if (i % 2 == 0) {
+        vset_add_atomic(a, i);
+      }
+      if (i % 3 == 0) {
+        vset_add_atomic(b, i);
+      }
+    }
+    assert(vset_count(a, n) == 100);
+    assert(vset_count(b, n) == 67);
+    vset_union(a, b, n);
+    assert(vset_count(a, n) == 133);
+    vset_difference(a, b, n);
+    assert(vset_count(a, n) == 66);
+    for (size_t i = 0; i < n; i++) {
+      assert(vset_test(a, i) == (i % 2 == 0 && i % 3 != 0));
+    }
+    vset_remove(a, 2);
+    vset_remove_atomic(a, 4);
+    assert(!vset_test(a, 2) && !vset_test(a, 4) && vset_count(a, n) == 64);
+    free(a);
+    free(b);
+  }
+
   matrix_destroy(m);
   matrix_destroy(m2);
 
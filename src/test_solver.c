@@ -1,4 +1,9 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <omp.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "graph.h"
 #include "solver.h"
@@ -27,7 +32,7 @@ int main(int argc, char *argv[]) {
     matrix_destroy(m);
     return 1;
   }
-  c->colors = calloc(m->n_vertices, sizeof(number_t));
+  c->colors = calloc(m->n_vertices, sizeof(color_t));
   if (c->colors == NULL) {
     free(c);
     fclose(f);
@@ -37,13 +42,283 @@ int main(int argc, char *argv[]) {
   c->colors_size = m->n_vertices;
 
   printf("luby_maximal_independent_set\n");
-  luby_maximal_independent_set(m, c, 1, NULL);
+  struct solver_context *ctx = solver_context_create(m);
+  assert(ctx != NULL);
+  luby_maximal_independent_set(ctx, c, 1, NULL, 1);
+  solver_context_destroy(ctx);
   printf("luby_maximal_independent_set done\n");
   matrix_verify_coloring(m, c, true);
   printf("matrix_verify_coloring done\n");
   matrix_as_dot_color(m, f, c);
   printf("matrix_as_dot_color done\n");
   
+  // the same seed gives the same coloring for any number of threads
+  {
+    struct matrix *m2 = matrix_create_random(0x1000, 0x2000);
+    assert(m2 != NULL);
+    size_t *degree = malloc(m2->n_vertices * sizeof(size_t));
+    assert(degree != NULL);
+    matrix_degree(m2, degree);
+    size_t max_degree = 0;
+    for (size_t i = 0; i < m2->n_vertices; i++) {
+      if (degree[i] > max_degree) {
+        max_degree = degree[i];
+      }
+    }
+    struct coloring c1 = { .colors = calloc(m2->n_vertices, sizeof(color_t)), .colors_size = m2->n_vertices };
+    struct coloring c4 = { .colors = calloc(m2->n_vertices, sizeof(color_t)), .colors_size = m2->n_vertices };
+    assert(c1.colors != NULL && c4.colors != NULL);
+    int n_threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    struct solver_context *ctx1 = solver_context_create(m2);
+    assert(ctx1 != NULL);
+    color_cliquelike(ctx1, &c1, max_degree, NULL, 42);
+    omp_set_num_threads(4);
+    struct solver_context *ctx4 = solver_context_create(m2);
+    assert(ctx4 != NULL);
+    color_cliquelike(ctx4, &c4, max_degree, NULL, 42);
+    // a context is reusable, and left as it was found
+    color_cliquelike(ctx4, &c1, max_degree, NULL, 42);
+    omp_set_num_threads(n_threads);
+    assert(matrix_verify_coloring(m2, &c1, false));
+    assert(memcmp(c1.colors, c4.colors, m2->n_vertices * sizeof(color_t)) == 0);
+    printf("color_cliquelike is deterministic\n");
+    // Jones-Plassmann, both priorities, is deterministic too and within max_degree + 1 colors
+    for (int ldf = 0; ldf <= 1; ldf++) {
+      omp_set_num_threads(1);
+      color_jones_plassmann(ctx1, &c1, ldf, 42);
+      omp_set_num_threads(4);
+      color_jones_plassmann(ctx4, &c4, ldf, 42);
+      omp_set_num_threads(n_threads);
+      assert(matrix_verify_coloring(m2, &c1, false));
+      assert(memcmp(c1.colors, c4.colors, m2->n_vertices * sizeof(color_t)) == 0);
+      assert(coloring_max_color(&c1) <= max_degree + 1);
+      printf("color_jones_plassmann (ldf=%d): %" PRIcolor " colors in %zu rounds\n", ldf, coloring_max_color(&c1), ctx4->rounds);
+    }
+    // smallest-last stays within degeneracy + 1 colors
+    size_t degeneracy = color_smallest_last(ctx4, &c4);
+    assert(matrix_verify_coloring(m2, &c4, false));
+    assert(coloring_max_color(&c4) <= degeneracy + 1);
+    printf("color_smallest_last: %" PRIcolor " colors, degeneracy %zu\n", coloring_max_color(&c4), degeneracy);
+
+    // color_cliquelike with only degeneracy + 1 colors still colors everything
+    color_cliquelike(ctx4, &c4, degeneracy + 1, NULL, 42);
+    assert(matrix_verify_coloring(m2, &c4, false));
+
+    // register allocation stays within k colors and spills exactly the
+    // uncolored vertices; with max_degree + 1 registers nothing spills
+    double *spill_cost = malloc(m2->n_vertices * sizeof(double));
+    number_t *spilled = malloc(m2->n_vertices * sizeof(number_t));
+    assert(spill_cost != NULL && spilled != NULL);
+    for (size_t i = 0; i < m2->n_vertices; i++) {
+      spill_cost[i] = 1.0 + i % 7;
+    }
+    size_t n_spilled = color_register_allocation(ctx4, &c4, 3, spill_cost, spilled);
+    assert(n_spilled > 0);
+    assert(matrix_verify_coloring(m2, &c4, true));
+    assert(coloring_max_color(&c4) <= 3);
+    for (size_t i = 0; i < n_spilled; i++) {
+      assert(c4.colors[spilled[i]] == 0);
+    }
+    size_t uncolored = 0;
+    for (size_t i = 0; i < m2->n_vertices; i++) {
+      uncolored += c4.colors[i] == 0;
+    }
+    assert(uncolored == n_spilled);
+    assert(color_register_allocation(ctx4, &c4, max_degree + 1, spill_cost, spilled) == 0);
+    assert(matrix_verify_coloring(m2, &c4, false));
+    printf("color_register_allocation: %zu of %zu vertices spilled with 3 registers\n", n_spilled, m2->n_vertices);
+    free(spill_cost);
+    free(spilled);
+
+    // distance-2 coloring on the CSR
+    color_distance2(ctx4, &c4);
+    assert(matrix_verify_distance2_coloring(m2, &c4));
+    printf("color_distance2: %" PRIcolor " colors\n", coloring_max_color(&c4));
+
+    // balancing keeps the coloring valid and narrows the class sizes
+    color_cliquelike(ctx4, &c4, max_degree, NULL, 42);
+    color_t colors_before = coloring_max_color(&c4);
+    size_t *class_size = calloc((size_t) colors_before + 1, sizeof(size_t));
+    assert(class_size != NULL);
+    for (size_t i = 0; i < m2->n_vertices; i++) {
+      class_size[c4.colors[i]]++;
+    }
+    size_t smallest = SIZE_MAX;
+    size_t largest = 0;
+    for (color_t color = 1; color <= colors_before; color++) {
+      smallest = class_size[color] < smallest ? class_size[color] : smallest;
+      largest = class_size[color] > largest ? class_size[color] : largest;
+    }
+    free(class_size);
+    size_t spread = color_balance(ctx4, &c4, 100, 42);
+    assert(matrix_verify_coloring(m2, &c4, false));
+    assert(coloring_max_color(&c4) <= colors_before);
+    assert(spread < largest - smallest);
+    printf("color_balance: spread %zu, was %zu, over %" PRIcolor " colors\n", spread, largest - smallest, colors_before);
+
+    // iterated greedy keeps the coloring valid and never adds colors
+    color_t before = coloring_max_color(&c4);
+    assert(color_iterated_greedy(ctx4, &c4, 10, 0, 42) <= before);
+    assert(matrix_verify_coloring(m2, &c4, false));
+
+    // the speculative engine depends on timing, so only check the result
+    color_speculative_greedy(ctx4, &c4);
+    assert(matrix_verify_coloring(m2, &c4, false));
+    assert(coloring_max_color(&c4) <= max_degree + 1);
+
+    // the random graph is not chordal, so color_chordal falls back to LDF
+    assert(!color_chordal(ctx4, &c4, 42));
+    assert(matrix_verify_coloring(m2, &c4, false));
+    // semi-external coloring from a saved copy, streamed in many small blocks
+    {
+      char path[] = "/tmp/test_solver_XXXXXX";
+      int fd = mkstemp(path);
+      assert(fd >= 0);
+      close(fd);
+      int saved = matrix_save(m2, path);
+      assert(saved == 0);
+      struct coloring c5;
+      assert(color_semi_external(path, &c5, 4096) == 0);
+      assert(c5.colors_size == m2->n_vertices);
+      assert(matrix_verify_coloring(m2, &c5, false));
+      printf("color_semi_external: %" PRIcolor " colors\n", coloring_max_color(&c5));
+      free(c5.colors);
+      // a column id past the last vertex, a row offset going back, and a
+      // file cut short are all rejected
+      const size_t col_index_offset = matrix_file_col_index_offset(m2->n_vertices, sizeof(offset_t));
+      const size_t row_1_offset = sizeof(struct matrix_file_header) + sizeof(offset_t);
+      number_t bad_col = m2->n_vertices;
+      offset_t bad_row = m2->row_index[2] + 1;
+      fd = open(path, O_WRONLY);
+      assert(fd >= 0);
+      ssize_t written = pwrite(fd, &bad_col, sizeof(number_t), col_index_offset + 10 * sizeof(number_t));
+      assert(written == sizeof(number_t));
+      int status = color_semi_external(path, &c5, 4096);
+      assert(status == 1);
+      written = pwrite(fd, &m2->col_index[10], sizeof(number_t), col_index_offset + 10 * sizeof(number_t));
+      assert(written == sizeof(number_t));
+      written = pwrite(fd, &bad_row, sizeof(offset_t), row_1_offset);
+      assert(written == sizeof(offset_t));
+      status = color_semi_external(path, &c5, 4096);
+      assert(status == 1);
+      written = pwrite(fd, &m2->row_index[1], sizeof(offset_t), row_1_offset);
+      assert(written == sizeof(offset_t));
+      int truncated = ftruncate(fd, col_index_offset + (m2->nnz - 1) * sizeof(number_t));
+      assert(truncated == 0);
+      status = color_semi_external(path, &c5, 4096);
+      assert(status == 1);
+      close(fd);
+      unlink(path);
+    }
+
+    // dynamic recoloring repairs only what a batch of updates touched
+    color_jones_plassmann(ctx4, &c4, true, 42);
+    struct dynamic_graph *dg = dynamic_graph_create(m2, &c4);
+    assert(dg != NULL);
+    struct matrix_al_pair inserted[200];
+    for (size_t e = 0; e < 200; e++) {
+      inserted[e] = (struct matrix_al_pair) { .i = hash64(e) % m2->n_vertices, .j = hash64(e + 1000) % m2->n_vertices };
+    }
+    dynamic_graph_insert_edges(dg, inserted, 200);
+    struct matrix_al_pair deleted[100];
+    size_t n_deleted = 0;
+    for (size_t u = 0; u < m2->n_vertices && n_deleted < 100; u++) {
+      for (size_t j = m2->row_index[u]; j < m2->row_index[u + 1] && n_deleted < 100; j++) {
+        deleted[n_deleted++] = (struct matrix_al_pair) { .i = u, .j = m2->col_index[j] };
+      }
+    }
+    dynamic_graph_delete_edges(dg, deleted, n_deleted);
+    number_t first = dynamic_graph_insert_vertices(dg, 10);
+    assert(first == m2->n_vertices);
+    for (size_t e = 0; e < 50; e++) {
+      inserted[e] = (struct matrix_al_pair) { .i = first + e % 10, .j = hash64(e + 2000) % (first + 10) };
+    }
+    dynamic_graph_insert_edges(dg, inserted, 50);
+    number_t gone[] = {1, 2, 3, first};
+    dynamic_graph_delete_vertices(dg, gone, 4);
+    size_t repaired = dynamic_graph_recolor(dg);
+    assert(repaired < m2->n_vertices / 4);
+    struct matrix *m3 = dynamic_graph_snapshot(dg);
+    assert(m3 != NULL && m3->n_vertices == first + 10);
+    assert(matrix_verify_coloring(m3, &dg->c, false));
+    for (size_t i = first + 1; i < first + 10; i++) {
+      assert(dg->c.colors[i] != 0);
+    }
+    assert(dynamic_graph_recolor(dg) == 0);
+    printf("dynamic_graph_recolor: %zu vertices repaired\n", repaired);
+    matrix_destroy(m3);
+    dynamic_graph_destroy(dg);
+
+    solver_context_destroy(ctx1);
+    solver_context_destroy(ctx4);
+    free(c1.colors);
+    free(c4.colors);
+    free(degree);
+    matrix_destroy(m2);
+  }
+
+  // a 5-clique with a path hanging off it is chordal and needs exactly 5 colors
+  {
+    struct matrix_al_pair edges[] = {
+      {0, 1}, {0, 2}, {0, 3}, {0, 4}, {1, 2}, {1, 3}, {1, 4}, {2, 3}, {2, 4}, {3, 4},
+      {4, 5}, {5, 6}, {6, 7},
+    };
+    struct matrix *m3 = matrix_create_from_edges(8, edges, sizeof(edges) / sizeof(edges[0]));
+    assert(m3 != NULL);
+    struct solver_context *ctx = solver_context_create(m3);
+    struct coloring c = { .colors = calloc(8, sizeof(color_t)), .colors_size = 8 };
+    assert(c.colors != NULL);
+    assert(color_chordal(ctx, &c, 42));
+    assert(matrix_verify_coloring(m3, &c, false));
+    assert(coloring_max_color(&c) == 5);
+    printf("color_chordal: %" PRIcolor " colors\n", coloring_max_color(&c));
+    solver_context_destroy(ctx);
+    free(c.colors);
+    matrix_destroy(m3);
+  }
+
+  // a star's hub and leaves are all within distance 2, so they need 301
+  // colors; the scratch is sized by that and not by max_degree^2
+  {
+    const size_t n_vertices = 70000;
+    struct matrix_al_pair edges[300];
+    for (size_t i = 0; i < 300; i++) {
+      edges[i] = (struct matrix_al_pair) {0, i + 1};
+    }
+    struct matrix *m3 = matrix_create_from_edges(n_vertices, edges, 300);
+    assert(m3 != NULL);
+    struct solver_context *ctx = solver_context_create(m3);
+    struct coloring c = { .colors = calloc(n_vertices, sizeof(color_t)), .colors_size = n_vertices };
+    assert(ctx != NULL && c.colors != NULL);
+    color_distance2(ctx, &c);
+    assert(matrix_verify_distance2_coloring(m3, &c));
+    assert(coloring_max_color(&c) == 301);
+    printf("color_distance2 on a star: %" PRIcolor " colors\n", coloring_max_color(&c));
+    solver_context_destroy(ctx);
+    free(c.colors);
+    matrix_destroy(m3);
+  }
+
+  // a batch of small graphs plus one outlier
+  {
+    struct matrix *graphs[33];
+    struct coloring colorings[33];
+    for (size_t b = 0; b < 33; b++) {
+      graphs[b] = b < 32 ? matrix_create_random(16 + b, 32 + 3 * b) : matrix_create_random(0x1000, 0x2000);
+      assert(graphs[b] != NULL);
+      colorings[b] = (struct coloring) { .colors = malloc(graphs[b]->n_vertices * sizeof(color_t)), .colors_size = graphs[b]->n_vertices };
+      assert(colorings[b].colors != NULL);
+    }
+    assert(color_batch((const struct matrix *const *) graphs, colorings, 33, 0x100, 42) == 1);
+    for (size_t b = 0; b < 33; b++) {
+      assert(matrix_verify_coloring(graphs[b], &colorings[b], false));
+      matrix_destroy(graphs[b]);
+      free(colorings[b].colors);
+    }
+    printf("color_batch: 33 graphs colored\n");
+  }
+
   fclose(f);
   matrix_destroy(m);
   return 0;
@@ -9,12 +9,36 @@
 static size_t n_vertices = 0;
 static size_t nnz = 0;
 static char *filename = NULL;
+static char *input_filename = NULL;
+static bool reorder = false;
+static enum matrix_order order;
+static uint64_t seed = 1;
+static enum solver_engine engine = SOLVER_LUBY;
+static size_t refine_iterations = 0;
+static double refine_seconds = 0;
+static size_t registers = 0;
+static size_t balance_rounds = 0;
+static size_t batch = 0;
+static size_t block_bytes = 0;
+// graphs above this many vertices in a batch get intra-graph parallelism
+static size_t outlier_vertices = 1 << 14;
 
 void print_usage() {
-  fprintf(stderr, "Usage: test_solver_color -n <n_vertices> -nnz <nnz> -f <filename>\n");
+  fprintf(stderr, "Usage: test_solver_color (-n <n_vertices> -nnz <nnz> | -i <input>) -f <filename>\n");
   fprintf(stderr, "  -n <n_vertices>  Number of vertices in the graph\n");
   fprintf(stderr, "  -nnz <nnz>       Number of non-zero elements in the graph\n");
+  fprintf(stderr, "  -i <input>       Load the graph (.mtx, edge list, or matrix_save output) instead\n");
   fprintf(stderr, "  -f <filename>    Output filename for the graph\n");
+  fprintf(stderr, "  -r <order>       Renumber the vertices before coloring (rcm, degree or bfs)\n");
+  fprintf(stderr, "  -s <seed>        Seed for the solver's random choices (default 1)\n");
+  fprintf(stderr, "  -a <engine>      Coloring engine: luby (default), jp, ldf, greedy, sl, chordal or d2\n");
+  fprintf(stderr, "  -g <iterations>  Refine the coloring with up to <iterations> iterated greedy passes\n");
+  fprintf(stderr, "  -t <seconds>     Stop the iterated greedy refinement after <seconds>\n");
+  fprintf(stderr, "  -b <rounds>      Balance the color class sizes for up to <rounds> rounds\n");
+  fprintf(stderr, "  -m <graphs>      Color <graphs> random graphs of this size as one batch instead\n");
+  fprintf(stderr, "  -o <vertices>    In a batch, graphs over <vertices> are colored in parallel (default 16384)\n");
+  fprintf(stderr, "  -e <bytes>       Color semi-externally, streaming the saved CSR in blocks of <bytes>\n");
+  fprintf(stderr, "  -k <registers>   Allocate <registers> colors with spilling (unit spill costs) instead\n");
 }
 
 int parse_args(int argc, char *argv[]) {
@@ -31,42 +55,272 @@ int parse_args(int argc, char *argv[]) {
       filename = argv[2];
       argc -= 2;
       argv += 2;
+    } else if (strcmp(argv[1], "-i") == 0) {
+      input_filename = argv[2];
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-a") == 0) {
+      if (solver_engine_parse(argv[2], &engine) != 0) {
+        print_usage();
+        fprintf(stderr, "Unknown engine: %s\n", argv[2]);
+        return 1;
+      }
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-g") == 0) {
+      refine_iterations = strtoul(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-t") == 0) {
+      refine_seconds = strtod(argv[2], NULL);
+      if (refine_iterations == 0) {
+        refine_iterations = SIZE_MAX;
+      }
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-b") == 0) {
+      balance_rounds = strtoul(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-m") == 0) {
+      batch = strtoul(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-o") == 0) {
+      outlier_vertices = strtoul(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-e") == 0) {
+      block_bytes = strtoul(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-k") == 0) {
+      registers = strtoul(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-s") == 0) {
+      seed = strtoull(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-r") == 0) {
+      reorder = true;
+      if (strcmp(argv[2], "rcm") == 0) {
+        order = MATRIX_ORDER_RCM;
+      } else if (strcmp(argv[2], "degree") == 0) {
+        order = MATRIX_ORDER_DEGREE;
+      } else if (strcmp(argv[2], "bfs") == 0) {
+        order = MATRIX_ORDER_BFS;
+      } else {
+        print_usage();
+        fprintf(stderr, "Unknown order: %s\n", argv[2]);
+        return 1;
+      }
+      argc -= 2;
+      argv += 2;
     } else {
       print_usage();
       fprintf(stderr, "Unknown argument: %s\n", argv[1]);
       return 1;
     }
   }
-  if (n_vertices == 0) {
+  if (n_vertices == 0 && input_filename == NULL) {
     print_usage();
     fprintf(stderr, "Number of vertices must be specified with -n\n");
     return 1;
   }
-  if (nnz == 0) {
+  if (nnz == 0 && input_filename == NULL) {
     print_usage();
     fprintf(stderr, "Number of non-zero elements must be specified with -nnz\n");
     return 1;
   }
-  if (filename == NULL) {
+  if (filename == NULL && batch == 0) {
     print_usage();
     fprintf(stderr, "Output filename must be specified with -f\n");
     return 1;
   }
+  if (engine == SOLVER_DISTANCE2 && refine_iterations > 0) {
+    print_usage();
+    fprintf(stderr, "Iterated greedy (-g, -t) recolors at distance 1, so it cannot refine -a d2\n");
+    return 1;
+  }
+  if (engine == SOLVER_DISTANCE2 && balance_rounds > 0) {
+    print_usage();
+    fprintf(stderr, "Balancing (-b) moves vertices at distance 1, so it cannot balance -a d2\n");
+    return 1;
+  }
+  return 0;
+}
+
+// Colors ctx->g as the arguments ask: with the engine, then refined and
+// balanced, or by register allocation, storing the number of vertices
+// spilled. Returns 0 on success.
+int color_graph(struct solver_context *ctx, struct coloring *c, const size_t max_degree, size_t *n_spilled) {
+  *n_spilled = 0;
+  if (registers == 0) {
+    solver_color(ctx, c, engine, max_degree, seed);
+    if (refine_iterations > 0) {
+      color_iterated_greedy(ctx, c, refine_iterations, refine_seconds, seed);
+    }
+    if (balance_rounds > 0) {
+      color_balance(ctx, c, balance_rounds, seed);
+    }
+    return 0;
+  }
+  double *spill_cost = malloc(c->colors_size * sizeof(double));
+  number_t *spilled = malloc(c->colors_size * sizeof(number_t));
+  if (spill_cost == NULL || spilled == NULL) {
+    free(spill_cost);
+    free(spilled);
+    return 1;
+  }
+  for (size_t i = 0; i < c->colors_size; i++) {
+    spill_cost[i] = 1.0;
+  }
+  *n_spilled = color_register_allocation(ctx, c, registers, spill_cost, spilled);
+  free(spill_cost);
+  free(spilled);
   return 0;
 }
 
+// Colors batch random graphs with color_batch and verifies them all.
+int run_batch() {
+  double t01_start = get_wtime();
+  struct matrix **graphs = calloc(batch, sizeof(struct matrix *));
+  struct coloring *colorings = calloc(batch, sizeof(struct coloring));
+  if (graphs == NULL || colorings == NULL) {
+    free(graphs);
+    free(colorings);
+    return 1;
+  }
+  int status = 0;
+  for (size_t b = 0; b < batch && status == 0; b++) {
+    graphs[b] = matrix_create_random(n_vertices, nnz);
+    colorings[b].colors = malloc(n_vertices * sizeof(color_t));
+    colorings[b].colors_size = n_vertices;
+    if (graphs[b] == NULL || colorings[b].colors == NULL) {
+      status = 1;
+    }
+  }
+  double t02_create_random_matrix = get_wtime();
+  double t03_color_batch = t02_create_random_matrix;
+  if (status == 0) {
+    size_t n_outliers = color_batch((const struct matrix *const *) graphs, colorings, batch, outlier_vertices, seed);
+    t03_color_batch = get_wtime();
+    color_t max_color = 0;
+    for (size_t b = 0; b < batch && status == 0; b++) {
+      if (!matrix_verify_coloring(graphs[b], &colorings[b], false)) {
+        fprintf(stderr, "Coloring verification failed for graph %zu\n", b);
+        status = 1;
+      }
+      color_t colors = coloring_max_color(&colorings[b]);
+      max_color = colors > max_color ? colors : max_color;
+    }
+    printf("graphs: %zu (%zu outliers)\n", batch, n_outliers);
+    printf("colors used: %" PRIcolor " at most\n", max_color);
+  }
+  double t04_verify_coloring = get_wtime();
+
+  printf("=== timing report ===\n");
+  printf("matrix_create_random:   %03f s\n", t02_create_random_matrix - t01_start);
+  printf("color_batch:            %03f s\n", t03_color_batch - t02_create_random_matrix);
+  printf("matrix_verify_coloring: %03f s\n", t04_verify_coloring - t03_color_batch);
+  printf("=== end timing report ===\n");
+  printf("number of OMP threads:  %d\n", get_num_omp_threads());
+
+  for (size_t b = 0; b < batch; b++) {
+    matrix_destroy(graphs[b]);
+    free(colorings[b].colors);
+  }
+  free(graphs);
+  free(colorings);
+  return status;
+}
+
+// Colors m with color_semi_external, from the input file if it is in the
+// matrix_save format and otherwise from a copy saved next to filename, and
+// verifies the result against m.
+int run_semi_external(const struct matrix *m) {
+  char *path = input_filename;
+  if (m->mapping == NULL) {
+    path = malloc(strlen(filename) + sizeof(".csr"));
+    if (path == NULL) {
+      return 1;
+    }
+    sprintf(path, "%s.csr", filename);
+    if (matrix_save(m, path) != 0) {
+      fprintf(stderr, "Cannot save %s\n", path);
+      free(path);
+      return 1;
+    }
+  }
+  double t01_start = get_wtime();
+  struct coloring c;
+  int status = color_semi_external(path, &c, block_bytes);
+  double t02_color_semi_external = get_wtime();
+  if (status != 0) {
+    fprintf(stderr, "Cannot read %s\n", path);
+  } else {
+    printf("colors used: %" PRIcolor "\n", coloring_max_color(&c));
+    if (!matrix_verify_coloring(m, &c, false)) {
+      fprintf(stderr, "Coloring verification failed\n");
+      status = 1;
+    }
+    free(c.colors);
+  }
+  printf("=== timing report ===\n");
+  printf("color_semi_external:    %03f s\n", t02_color_semi_external - t01_start);
+  printf("=== end timing report ===\n");
+  printf("number of OMP threads:  %d\n", get_num_omp_threads());
+  if (path != input_filename) {
+    free(path);
+  }
+  return status;
+}
+
 int main(int argc, char *argv[]) {
   if (parse_args(argc, argv) != 0) {
     return 1;
   }
+  if (batch > 0) {
+    return run_batch();
+  }
 
   double t01_start = get_wtime();
-  printf("matrix_create_random(%zu, %zu)\n", n_vertices, nnz);
-  struct matrix *m = matrix_create_random(n_vertices, nnz);
+  struct matrix *m;
+  if (input_filename != NULL) {
+    printf("matrix_load(%s)\n", input_filename);
+    m = matrix_load(input_filename);
+  } else {
+    printf("matrix_create_random(%zu, %zu)\n", n_vertices, nnz);
+    m = matrix_create_random(n_vertices, nnz);
+  }
   if (m == NULL) {
     return 1;
   }
   double t02_create_random_matrix = get_wtime();
+  if (block_bytes > 0) {
+    int status = run_semi_external(m);
+    matrix_destroy(m);
+    return status;
+  }
+
+  // g is the graph that gets colored: m itself, or m renumbered by perm
+  struct matrix *g = m;
+  number_t *perm = NULL;
+  if (reorder) {
+    perm = malloc(m->n_vertices * sizeof(number_t));
+    if (perm == NULL) {
+      matrix_destroy(m);
+      return 1;
+    }
+    g = matrix_reorder(m, order, perm);
+    if (g == NULL) {
+      free(perm);
+      matrix_destroy(m);
+      return 1;
+    }
+  }
+  double t02_reorder = get_wtime();
 
   // matrix_print(m);
   
@@ -84,8 +338,8 @@ int main(int argc, char *argv[]) {
     matrix_destroy(m);
     return 1;
   }
-  printf("allocate coloring.colors - %x bytes\n", m->n_vertices * sizeof(number_t));
-  c->colors = calloc(m->n_vertices, sizeof(number_t));
+  printf("allocate coloring.colors - %x bytes\n", m->n_vertices * sizeof(color_t));
+  c->colors = calloc(m->n_vertices, sizeof(color_t));
   if (c->colors == NULL) {
     free(c);
     fclose(f);
@@ -115,12 +369,41 @@ int main(int argc, char *argv[]) {
 
   printf("max degree: %zu\n", max_degree);
 
-  color_cliquelike(m, c, max_degree, NULL);
+  struct solver_context *ctx = solver_context_create(g);
+  if (ctx == NULL) {
+    return 1;
+  }
+  size_t n_spilled = 0;
+  if (reorder) {
+    struct coloring gc = {
+      .colors = calloc(g->n_vertices, sizeof(color_t)),
+      .colors_size = g->n_vertices,
+    };
+    if (gc.colors == NULL) {
+      return 1;
+    }
+    if (color_graph(ctx, &gc, max_degree, &n_spilled) != 0) {
+      return 1;
+    }
+    coloring_unpermute(&gc, perm, c);
+    free(gc.colors);
+  } else {
+    if (color_graph(ctx, c, max_degree, &n_spilled) != 0) {
+      return 1;
+    }
+  }
   double t04_color_cliquelike = get_wtime();
+  printf("colors used: %" PRIcolor "\n", coloring_max_color(c));
+  printf("rounds: %zu\n", ctx->rounds);
+  if (registers > 0) {
+    printf("spilled: %zu\n", n_spilled);
+  }
+  solver_context_destroy(ctx);
   matrix_as_dot_color(m, f, c);
   double t05_as_dot_color = get_wtime();
 
-  if (!matrix_verify_coloring(m, c, false)) {
+  bool valid = registers == 0 && engine == SOLVER_DISTANCE2 ? matrix_verify_distance2_coloring(m, c) : matrix_verify_coloring(m, c, registers > 0);
+  if (!valid) {
     fprintf(stderr, "Coloring verification failed\n");
     free(c->colors);
     free(c);
@@ -133,7 +416,10 @@ int main(int argc, char *argv[]) {
 
   printf("=== timing report ===\n");
   printf("matrix_create_random:   %03f s\n", t02_create_random_matrix - t01_start);
-  printf("matrix_degree:          %03f s\n", t03_etc - t02_create_random_matrix);
+  if (reorder) {
+    printf("matrix_reorder:         %03f s\n", t02_reorder - t02_create_random_matrix);
+  }
+  printf("matrix_degree:          %03f s\n", t03_etc - t02_reorder);
   printf("color_cliquelike:       %03f s\n", t04_color_cliquelike - t03_etc);
   printf("matrix_as_dot_color:    %03f s\n", t05_as_dot_color - t04_color_cliquelike);
   printf("matrix_verify_coloring: %03f s\n", t06_verify_coloring - t05_as_dot_color);
@@ -141,6 +427,10 @@ int main(int argc, char *argv[]) {
   printf("number of OMP threads:  %d\n", get_num_omp_threads());
   
   fclose(f);
+  if (g != m) {
+    matrix_destroy(g);
+  }
+  free(perm);
   matrix_destroy(m);
   free(c->colors);
   free(c);
@@ -11,12 +11,20 @@
 static size_t n_vertices = 0;
 static size_t n_edges = 0;
 static char *filename = NULL;
+static char *input_filename = NULL;
+static char *save_filename = NULL;
+static uint64_t seed = 1;
+static enum solver_engine engine = SOLVER_LUBY;
 
 void print_usage() {
-  fprintf(stderr, "Usage: test_solver_distributed -n <n_vertices> -nnz <n_edges> -f <filename>\n");
+  fprintf(stderr, "Usage: test_solver_distributed (-n <n_vertices> -nnz <n_edges> | -i <input>) -f <filename>\n");
   fprintf(stderr, "  -n <n_vertices>  Number of vertices in the graph\n");
   fprintf(stderr, "  -nnz <n_edges>       Number of non-zero elements in the graph\n");
+  fprintf(stderr, "  -i <input>       Load the graph (.mtx, edge list, or matrix_save output) instead\n");
+  fprintf(stderr, "  -w <output>      Save the generated graph with matrix_save\n");
   fprintf(stderr, "  -f <filename>    Output filename for the graph\n");
+  fprintf(stderr, "  -s <seed>        Seed for the solver's random choices (default 1)\n");
+  fprintf(stderr, "  -a <engine>      Coloring engine: luby (default), jp, ldf, greedy, sl, chordal or d2\n");
 }
 
 int parse_args(int argc, char *argv[], bool silent) {
@@ -33,6 +41,28 @@ int parse_args(int argc, char *argv[], bool silent) {
       filename = argv[2];
       argc -= 2;
       argv += 2;
+    } else if (strcmp(argv[1], "-i") == 0) {
+      input_filename = argv[2];
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-w") == 0) {
+      save_filename = argv[2];
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-a") == 0) {
+      if (solver_engine_parse(argv[2], &engine) != 0) {
+        if (!silent) {
+          print_usage();
+          fprintf(stderr, "Unknown engine: %s\n", argv[2]);
+        }
+        return 1;
+      }
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[1], "-s") == 0) {
+      seed = strtoull(argv[2], NULL, 10);
+      argc -= 2;
+      argv += 2;
     } else {
       if (!silent) {
         print_usage();
@@ -41,14 +71,14 @@ int parse_args(int argc, char *argv[], bool silent) {
       return 1;
     }
   }
-  if (n_vertices == 0) {
+  if (n_vertices == 0 && input_filename == NULL) {
     if (!silent) {
       print_usage();
       fprintf(stderr, "Number of vertices must be specified with -n\n");
     }
     return 1;
   }
-  if (n_edges == 0) {
+  if (n_edges == 0 && input_filename == NULL) {
     if (!silent) {
       print_usage();
       fprintf(stderr, "Number of non-zero elements must be specified with -nnz\n");
@@ -82,32 +112,61 @@ int main(int argc, char *argv[]) {
   double t06_as_dot_color = 0;
   double t07_verify_coloring = 0;
 
-  struct matrix *m;
+  struct matrix *m = NULL;
+  int mapped = 0;
+  uint64_t dimensions[2];
   if (rank == 0) {
     t01_start = get_wtime();
-    printf("matrix_create_random(%zu, %zu)\n", n_vertices, n_edges);
-    m = matrix_create_random(n_vertices, n_edges);
-    assert(m != NULL);
-    assert(m->nnz == 2*n_edges);
-    assert(m->n_vertices == n_vertices);
+    if (input_filename != NULL) {
+      printf("matrix_load(%s)\n", input_filename);
+      m = matrix_load(input_filename);
+      assert(m != NULL);
+      printf("loaded %zu vertices, %zu nnz\n", m->n_vertices, m->nnz);
+    } else {
+      printf("matrix_create_random(%zu, %zu)\n", n_vertices, n_edges);
+      m = matrix_create_random(n_vertices, n_edges);
+      assert(m != NULL);
+      assert(m->nnz == 2*n_edges);
+      assert(m->n_vertices == n_vertices);
+    }
     t02_create_random_matrix = get_wtime();
-  } else {
-    m = malloc(sizeof(struct matrix));
-    m->n_vertices = n_vertices;
-    m->nnz = 2*n_edges;
-    m->col_index = malloc(m->nnz * sizeof(number_t));
-    m->row_index = malloc((n_vertices + 1) * sizeof(number_t));
-  }
-  if (rank == 0) {
-    printf("broadcasting matrix\n");
+    if (save_filename != NULL) {
+      printf("matrix_save(%s)\n", save_filename);
+      if (matrix_save(m, save_filename) != 0) {
+        fprintf(stderr, "Cannot save %s\n", save_filename);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    }
+    mapped = m->mapping != NULL;
+    dimensions[0] = m->n_vertices;
+    dimensions[1] = m->nnz;
   }
-  int result = MPI_Bcast(m->col_index, m->nnz, NUMBER_T_MPI, 0, MPI_COMM_WORLD);
-  assert(result == MPI_SUCCESS);
-  MPI_Barrier(MPI_COMM_WORLD);
-  result = MPI_Bcast(m->row_index, (m->n_vertices + 1), NUMBER_T_MPI, 0, MPI_COMM_WORLD);
+  int result = MPI_Bcast(&mapped, 1, MPI_INT, 0, MPI_COMM_WORLD);
   assert(result == MPI_SUCCESS);
-  if (rank == 0) {
-    printf("done broadcasting matrix\n");
+  if (mapped) {
+    // every rank maps the file itself; ranks on the same node share the page cache
+    if (rank != 0) {
+      m = matrix_open_mmap(input_filename);
+      assert(m != NULL);
+    }
+  } else {
+    result = MPI_Bcast(dimensions, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    assert(result == MPI_SUCCESS);
+    if (rank != 0) {
+      m = matrix_create(dimensions[0], dimensions[1]);
+      assert(m != NULL);
+    }
+    if (rank == 0) {
+      printf("broadcasting matrix\n");
+    }
+    result = MPI_Bcast(m->col_index, m->nnz, NUMBER_T_MPI, 0, MPI_COMM_WORLD);
+    assert(result == MPI_SUCCESS);
+    MPI_Barrier(MPI_COMM_WORLD);
+    result = MPI_Bcast(m->row_index, (m->n_vertices + 1), OFFSET_T_MPI, 0, MPI_COMM_WORLD);
+    assert(result == MPI_SUCCESS);
+    if (rank == 0) {
+      printf("done broadcasting matrix\n");
+    }
   }
 
   {
@@ -125,9 +184,9 @@ int main(int argc, char *argv[]) {
   struct coloring *c = malloc(sizeof(struct coloring));
   assert(c != NULL);
   if (rank == 0) {
-    printf("allocate coloring.colors - %lx bytes\n", m->n_vertices * sizeof(number_t));
+    printf("allocate coloring.colors - %lx bytes\n", m->n_vertices * sizeof(color_t));
   }
-  c->colors = calloc(m->n_vertices, sizeof(number_t));
+  c->colors = calloc(m->n_vertices, sizeof(color_t));
   assert(c->colors != NULL);
   c->colors_size = m->n_vertices;
 
@@ -143,7 +202,23 @@ int main(int argc, char *argv[]) {
       max_degree = degree[i];
     }
   }
+  // Luby's independent sets cover every vertex within max_degree + 1 colors;
+  // only smallest-last order is bounded by degeneracy + 1, so only it pays
+  // for the peel
   size_t k = max_degree + 1;
+  if (engine == SOLVER_SMALLEST_LAST) {
+    number_t *order = malloc(m->n_vertices * sizeof(number_t));
+    assert(order != NULL);
+    size_t degeneracy = matrix_degeneracy_order(m, order, NULL);
+    free(order);
+    k = degeneracy + 1;
+    if (rank == 0) {
+      printf("degeneracy: %zu\n", degeneracy);
+    }
+  }
+  if (k < 2) {
+    k = 2;
+  }
 
   if (rank == 0) {
     t03_etc = get_wtime();
@@ -152,8 +227,11 @@ int main(int argc, char *argv[]) {
   }
   size_t subgraphs_length;
   struct subgraph *subgraphs;
+  struct solver_context *ctx = NULL;
   if (rank == 0) {
-    subgraphs = detect_subgraph(m, k, &subgraphs_length);
+    ctx = solver_context_create(m);
+    assert(ctx != NULL);
+    subgraphs = detect_subgraph(ctx, k, &subgraphs_length);
     printf("there are %zu subgraphs\n", subgraphs_length);
   }
   result = MPI_Bcast(&subgraphs_length, sizeof(size_t), MPI_BYTE, 0, MPI_COMM_WORLD);
@@ -172,7 +250,7 @@ int main(int argc, char *argv[]) {
       } else {
         // probably we should MPI_Type_create_struct here but I am too lazy
         printf("[rank %02d] sending subgraph (root index %zu) to rank %d\n", rank, i, dest_rank);
-        int result = MPI_Send(subgraphs[i].vertices, m->n_vertices * sizeof(bool), MPI_BYTE, dest_rank, 0, MPI_COMM_WORLD);
+        int result = MPI_Send(subgraphs[i].vertices, VSET_WORDS(m->n_vertices), MPI_UINT64_T, dest_rank, 0, MPI_COMM_WORLD);
         assert(result == MPI_SUCCESS);
       }
     }
@@ -181,27 +259,41 @@ int main(int argc, char *argv[]) {
     printf("[rank %02d] receiving %zu subgraphs\n", rank, subgraphs_length_for_me);
     for (size_t i = 0; i < subgraphs_length_for_me; i++) {
       printf("[rank %02d] receiving subgraph (my index %zu)\n", rank, i);
-      my_subgraphs[i].vertices = malloc(m->n_vertices * sizeof(bool));
+      my_subgraphs[i].vertices = vset_create(m->n_vertices);
       assert(my_subgraphs[i].vertices != NULL);
-      int result = MPI_Recv(my_subgraphs[i].vertices, m->n_vertices * sizeof(bool), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      int result = MPI_Recv(my_subgraphs[i].vertices, VSET_WORDS(m->n_vertices), MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
       assert(result == MPI_SUCCESS);
     }
     printf("[rank %02d] received %zu subgraphs\n", rank, subgraphs_length_for_me);
   }
 
+  number_t *new_vertex = malloc(m->n_vertices * sizeof(number_t));
+  number_t *old_vertex = malloc(m->n_vertices * sizeof(number_t));
+  assert(new_vertex != NULL && old_vertex != NULL);
   for (size_t i = 0; i < subgraphs_length_for_me; i++) {
     struct subgraph s = my_subgraphs[i];
-    size_t vertex_count = 0;
-    for (size_t j = 0; j < m->n_vertices; j++) {
-      if (s.vertices[j]) {
-        vertex_count++;
-      }
+    // color the subgraph on its own, with arrays sized to it
+    struct matrix *induced = matrix_induce(m, s.vertices, new_vertex, old_vertex);
+    assert(induced != NULL);
+    printf("[rank %02d] subgraph %zu has %zu vertices\n", rank, i, induced->n_vertices);
+    struct coloring induced_c = {
+      .colors = calloc(induced->n_vertices, sizeof(color_t)),
+      .colors_size = induced->n_vertices,
+    };
+    assert(induced_c.colors != NULL || induced->n_vertices == 0);
+    struct solver_context *induced_ctx = solver_context_create(induced);
+    assert(induced_ctx != NULL);
+    solver_color(induced_ctx, &induced_c, engine, k, seed);
+    printf("[rank %02d] subgraph %zu: %" PRIcolor " colors in %zu rounds\n", rank, i, coloring_max_color(&induced_c), induced_ctx->rounds);
+    solver_context_destroy(induced_ctx);
+    for (size_t j = 0; j < induced->n_vertices; j++) {
+      c->colors[old_vertex[j]] = induced_c.colors[j];
     }
-    printf("[rank %02d] subgraph %zu has %zu vertices\n", rank, i, vertex_count);
-    //struct matrix *selected = matrix_select(m, s.vertices);
-    //color_cliquelike(selected, c, k);
-    color_cliquelike(m, c, k, s.vertices);
+    free(induced_c.colors);
+    matrix_destroy(induced);
   }
+  free(new_vertex);
+  free(old_vertex);
   for (size_t i = 0; i < m->n_vertices; i++) {
     if (degree[i] == 0) {
       c->colors[i] = 1;
@@ -211,8 +303,8 @@ int main(int argc, char *argv[]) {
     for (size_t i = 0; i < (size_t) size-1; i++) {
       MPI_Status status;
       struct coloring *c_subgraph = malloc(sizeof(struct coloring));
-      c_subgraph->colors = malloc(m->n_vertices * sizeof(number_t));
-      result = MPI_Recv(c_subgraph->colors, m->n_vertices * sizeof(number_t), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+      c_subgraph->colors = malloc(m->n_vertices * sizeof(color_t));
+      result = MPI_Recv(c_subgraph->colors, m->n_vertices, COLOR_T_MPI, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
       assert(result == MPI_SUCCESS);
       int source_rank = status.MPI_SOURCE;
       printf("received coloring from rank %d\n", source_rank);
@@ -223,7 +315,7 @@ int main(int argc, char *argv[]) {
           continue;
         }
         for (size_t j = 0; j < m->n_vertices; j++) {
-          if (subgraphs[i].vertices[j]) {
+          if (vset_test(subgraphs[i].vertices, j)) {
             c->colors[j] = c_subgraph->colors[j];
           }
         }
@@ -231,10 +323,12 @@ int main(int argc, char *argv[]) {
     }
     printf("coloring done\n");
     t05_color_cliquelike = get_wtime();
-    color_cliquelike(m, c, k, NULL);
+    solver_color(ctx, c, engine, k, seed);
+    printf("colors used: %" PRIcolor "\n", coloring_max_color(c));
+    printf("rounds: %zu\n", ctx->rounds);
   } else {
     printf("[rank %02d] sending coloring to rank 0\n", rank);
-    result = MPI_Send(c->colors, m->n_vertices * sizeof(number_t), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+    result = MPI_Send(c->colors, m->n_vertices, COLOR_T_MPI, 0, 0, MPI_COMM_WORLD);
     assert(result == MPI_SUCCESS);
   }
 
@@ -262,6 +356,7 @@ int main(int argc, char *argv[]) {
     printf("=== end timing report ===\n");
     printf("number of OMP threads:  %d\n", get_num_omp_threads());
   }
+  solver_context_destroy(ctx);
 
   printf("[rank %02d] done, waiting for all ranks\n", rank);
   MPI_Barrier(MPI_COMM_WORLD);
@@ -83,7 +83,7 @@ int main(int argc, char *argv[]) {
   // matrix_print(m);
 
   struct coloring c = { 
-    .colors = calloc(m->n_vertices, sizeof(number_t)),
+    .colors = calloc(m->n_vertices, sizeof(color_t)),
     .colors_size = m->n_vertices
   };
   assert(c.colors != NULL);
@@ -115,7 +115,9 @@ int main(int argc, char *argv[]) {
   double t03_etc = get_wtime();
 
   size_t subgraphs_length;
-  struct subgraph *s = detect_subgraph(m, max_degree+1, &subgraphs_length);
+  struct solver_context *ctx = solver_context_create(m);
+  struct subgraph *s = ctx != NULL ? detect_subgraph(ctx, max_degree+1, &subgraphs_length) : NULL;
+  solver_context_destroy(ctx);
   if (s == NULL) {
     free(degree);
     fclose(f);
@@ -127,12 +129,7 @@ int main(int argc, char *argv[]) {
   double t04_detect_subgraph = get_wtime();
 
   for (size_t i = 0; i < subgraphs_length; i++) {
-    size_t count = 0;
-    for (size_t j = 0; j < m->n_vertices; j++) {
-      if (s[i].vertices[j]) {
-        count++;
-      }
-    }
+    size_t count = vset_count(s[i].vertices, m->n_vertices);
     printf("subgraph %zu has %zu vertices\n", i, count);
   }
   matrix_as_dot_subgraph_color(m, f, s, subgraphs_length, &c);